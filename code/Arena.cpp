@@ -0,0 +1,58 @@
+// © Copyright IBM Corporation 2022. All Rights Reserved.
+// LICENSE: Eclipse Public License - v 2.0, https://opensource.org/licenses/EPL-2.0
+// SPDX-License-Identifier: EPL-2.0
+
+#include "Arena.hpp"
+
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+Arena::~Arena()
+{
+  for(int i=0; i<(int)blocks_.size(); i++)
+    free(blocks_[i].data);
+}
+
+// Takes the memory from the current block, or from the next block
+// that is large enough, adding one if there is none
+void* Arena::allocateBytes(size_t bytes, size_t alignment)
+{
+  if(block_ >= 0) {
+    size_t start = (used_ + alignment - 1) & ~(alignment - 1);
+    if(start + bytes <= blocks_[block_].size) {
+      used_ = start + bytes;
+      return blocks_[block_].data + start;
+    }
+  }
+  // the blocks come from malloc, aligned for any type
+  for(block_++; block_<(int)blocks_.size(); block_++) {
+    if(bytes <= blocks_[block_].size)
+      break;
+  }
+  if(block_ == (int)blocks_.size()) {
+    Block block;
+    block.size = bytes > BLOCK_SIZE ? bytes : BLOCK_SIZE;
+    block.data = (char*)malloc(block.size);
+    if(!block.data)
+      throw bad_alloc();
+    blocks_.push_back(block);
+  }
+  used_ = bytes;
+  return blocks_[block_].data;
+}
+
+size_t Arena::getCapacity()
+{
+  size_t capacity = 0;
+  for(int i=0; i<(int)blocks_.size(); i++)
+    capacity += blocks_[i].size;
+  return capacity;
+}
+
+Arena& Arena::getThreadArena()
+{
+  static thread_local Arena arena;
+  return arena;
+}
@@ -0,0 +1,72 @@
+// © Copyright IBM Corporation 2022. All Rights Reserved.
+// LICENSE: Eclipse Public License - v 2.0, https://opensource.org/licenses/EPL-2.0
+// SPDX-License-Identifier: EPL-2.0
+
+#ifndef __ARENA_HPP__
+#define __ARENA_HPP__
+
+#include <cstddef>
+#include <vector>
+
+using namespace std;
+
+// Monotonic allocator for the transient arrays of the evaluation of a
+// test pair. Allocating only moves a pointer forward in a block and
+// nothing is freed until the arena is rewound to a mark, e.g. at the
+// end of each pair with ArenaScope. The blocks are kept when it is
+// rewound, so once they have grown to the largest pair the evaluation
+// does not call malloc. Each thread has its own arena, so the threads
+// do not contend for the allocator either. Only for types that need no
+// destructor; the memory is not initialized.
+class Arena {
+public:
+  struct Mark {
+    int block;
+    size_t used;
+  };
+
+private:
+  struct Block {
+    char* data;
+    size_t size;
+  };
+
+  static const size_t BLOCK_SIZE = 1 << 16;
+
+  vector<Block> blocks_;
+  int block_;   // block being used, -1 before the first allocation
+  size_t used_; // bytes used in it
+
+public:
+  Arena():block_(-1),used_(0) {}
+  ~Arena();
+
+  void* allocateBytes(size_t bytes, size_t alignment);
+  template<class T> T* allocate(size_t n)
+  {return (T*)allocateBytes(n*sizeof(T), alignof(T));}
+
+  Mark getMark() {Mark mark = {block_, used_}; return mark;}
+  void rewind(Mark mark) {block_ = mark.block; used_ = mark.used;}
+  void reset() {block_ = -1; used_ = 0;}
+  size_t getCapacity(); // bytes in all the blocks
+
+  static Arena& getThreadArena();
+
+private:
+  Arena(const Arena&);
+  Arena& operator=(const Arena&);
+};
+
+// Rewinds the arena at the end of the enclosing scope to where it was
+// when the scope started
+class ArenaScope {
+private:
+  Arena& arena_;
+  Arena::Mark mark_;
+
+public:
+  ArenaScope(Arena& arena):arena_(arena),mark_(arena.getMark()) {}
+  ~ArenaScope() {arena_.rewind(mark_);}
+};
+
+#endif
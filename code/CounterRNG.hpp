@@ -0,0 +1,83 @@
+// © Copyright IBM Corporation 2022. All Rights Reserved.
+// LICENSE: Eclipse Public License - v 2.0, https://opensource.org/licenses/EPL-2.0
+// SPDX-License-Identifier: EPL-2.0
+
+#ifndef __COUNTERRNG_HPP__
+#define __COUNTERRNG_HPP__
+
+#include <stdint.h>
+
+using namespace std;
+
+// Counter-based random numbers (Philox4x32-10). A draw is a pure
+// function of the seed and of a 4 word counter built from the stream
+// and three keys, so the same draw is obtained whatever the order of
+// evaluation or the thread doing it, and no state is shared.
+class CounterRNG {
+private:
+  uint32_t key0_;
+  uint32_t key1_;
+
+  static void mulhilo(uint32_t a, uint32_t b, uint32_t& hi, uint32_t& lo)
+  {
+    uint64_t product = (uint64_t)a * (uint64_t)b;
+    hi = (uint32_t)(product >> 32);
+    lo = (uint32_t)product;
+  }
+
+  void philox(uint32_t ctr[4])
+  {
+    uint32_t k0 = key0_;
+    uint32_t k1 = key1_;
+    for(int round=0; round<10; round++) {
+      uint32_t hi0, lo0, hi1, lo1;
+      mulhilo(0xD2511F53u, ctr[0], hi0, lo0);
+      mulhilo(0xCD9E8D57u, ctr[2], hi1, lo1);
+      uint32_t c0 = hi1 ^ ctr[1] ^ k0;
+      uint32_t c2 = hi0 ^ ctr[3] ^ k1;
+      ctr[0] = c0;
+      ctr[1] = lo1;
+      ctr[2] = c2;
+      ctr[3] = lo0;
+      k0 += 0x9E3779B9u;
+      k1 += 0xBB67AE85u;
+    }
+  }
+
+public:
+  // streams, so that different uses never share a counter
+  static const uint32_t RANDOM_BREAK_TEST = 1;
+  static const uint32_t RANDOM_BREAK_VALID = 2;
+  static const uint32_t MIDPOINT_TEST = 3;
+  static const uint32_t HEURISTIC_RULES = 4;
+  static const uint32_t SYNTHETIC_GRAPH = 5;
+  static const uint32_t BENCHMARK = 6;
+  static const uint32_t EXTRA_COVERAGE_SAMPLE = 7;
+
+  CounterRNG(uint64_t seed=1234)
+    :key0_((uint32_t)seed),key1_((uint32_t)(seed >> 32)) {}
+  ~CounterRNG() {}
+
+  // uniform in [0,1)
+  double uniform(uint32_t stream, uint32_t k1, uint32_t k2, uint32_t k3)
+  {
+    uint32_t ctr[4] = {k1, k2, k3, stream};
+    philox(ctr);
+    uint64_t bits = ((uint64_t)ctr[0] << 21) | (uint64_t)(ctr[1] >> 11); // 53 bits
+    return bits * (1.0 / 9007199254740992.0);
+  }
+
+  bool coinFlip(uint32_t stream, uint32_t k1, uint32_t k2, uint32_t k3)
+  {
+    return uniform(stream, k1, k2, k3) < 0.5;
+  }
+
+  // uniform in {0, ..., n-1}
+  int uniformInt(int n, uint32_t stream, uint32_t k1, uint32_t k2, uint32_t k3)
+  {
+    int value = (int)(uniform(stream, k1, k2, k3) * n);
+    return value < n ? value : n-1;
+  }
+};
+
+#endif
@@ -41,6 +41,37 @@ bool Rule::operator<(Rule& r)
   return false;
 }
 
+void RuleTrie::addRule(Rule& rule)
+{
+  vector<int>& relationIds = rule.getRelationIds();
+  vector<bool>& isReverseArc = rule.getIsReverseArc();
+  int rulelength = rule.getLengthRule();
+
+  int node = 0;
+  for(int k=0; k<rulelength; k++) {
+    int position = isLeft_ ? rulelength - k - 1 : k;
+    int relationId = relationIds[position];
+    bool useInArcs = isLeft_ ? !isReverseArc[position] : isReverseArc[position];
+    int child = -1;
+    for(int i=0; i<(int)edges_[node].size(); i++) {
+      Edge& edge = edges_[node][i];
+      if(edge.relationId == relationId && edge.useInArcs == useInArcs) {
+	child = edge.child;
+	break;
+      }
+    }
+    if(child < 0) {
+      child = (int)edges_.size();
+      Edge edge = {relationId, useInArcs, child};
+      edges_[node].push_back(edge);
+      edges_.push_back(vector<Edge>());
+      rules_.push_back(vector<int>());
+    }
+    node = child;
+  }
+  rules_[node].push_back(numRules_++);
+}
+
 void Query::addEntityPair(int ent1, int ent2)
 {
   entpairs_.push_back(pair<int,int>(ent1,ent2));
@@ -97,6 +128,11 @@ void Data::cleanup()
   maprelations_.clear();
   relnodehasarc_.clear();
   relnodehasinvarc_.clear();
+  relnodehasarcbits_.clear();
+  relnodehasinvarcbits_.clear();
+  relnumarcs_.clear();
+  relsidesizes_.clear();
+  relsideoverlaps_.clear();
   query_.cleanup();
   for(int i=0; i<(int)queries_.size(); i++)
     queries_[i].cleanup();
@@ -105,6 +141,7 @@ void Data::cleanup()
   validdata_.cleanup();
   maxcomplexity_=0;
   repeatedNodesAllowed_=false;
+  planRuleWalks_=false;
 
 }
 
@@ -209,11 +246,13 @@ void Data::readTestFile(string fname, TestData& testdata, map<string,int>& mapen
 
 void Data::readData(Parameters& params, string dataFile)
 {
+  ScopedTimer timer(Profile::DATA_LOADING);
   string dname = params.getDirectory();
   repeatedNodesAllowed_ = params.getRepeatedNodesAllowed();
+  planRuleWalks_ = params.getPlanRuleWalks();
 
   // read entities
-  map<string,int> mapentities;
+  map<string,int>& mapentities = mapentities_;
   readStringIntFile(dname+"/entity2id.txt", entities_, mapentities);
 
   // create nodes
@@ -272,6 +311,18 @@ void Data::readData(Parameters& params, string dataFile)
     relnodehasinvarc_[idrelation][idhead] = true;
   }
 
+  int numWords = ((int)entities_.size()+63)/64;
+  relnodehasarcbits_.assign(relations_.size(), vector<uint64_t>(numWords, 0));
+  relnodehasinvarcbits_.assign(relations_.size(), vector<uint64_t>(numWords, 0));
+  for(int i=0; i<(int)arcs_.size(); i++) {
+    int idrelation = arcs_[i]->getIdRelation();
+    int idtail = arcs_[i]->getTail()->getId();
+    int idhead = arcs_[i]->getHead()->getId();
+    relnodehasarcbits_[idrelation][idtail>>6] |= (uint64_t)1 << (idtail&63);
+    relnodehasinvarcbits_[idrelation][idhead>>6] |= (uint64_t)1 << (idhead&63);
+  }
+  computeRelationStatistics();
+
 #if 0
   cout<<"arcs:"<<endl;;
   for (int i=0; i<(int)arcs_.size(); i++) {
@@ -334,15 +385,79 @@ void Data::getNumPaths(int relationId, Rule& rule, vector<int>& numpaths)
 
 }
 
+// Number of paths of the rule for each pair of the query of the
+// relation, up to maxPaths, without the arc of the pair
+void Data::getPathCounts(int relationId, Rule& rule, int maxPaths,
+			 vector<int>& counts)
+{
+  int numpairs = getNumPairsQuery(relationId);
+  vector<pair<int,int> >& pairs = queries_[relationId].getEntityPairs();
+  vector<Arc*>& outArcsWithRelation = queries_[relationId].getOutArcsWithRelation();
+
+  counts.resize(numpairs);
+  for (int i=0; i<numpairs; i++)
+    counts[i] = countPathsExcluding(rule, pairs[i], ExcludedArc(outArcsWithRelation[i]), maxPaths);
+}
+
 bool Data::hasPath(Rule& rule, pair<int,int>& pair)
 {
-  return hasPathDfs(rule, pair);
+  return hasPathExcluding(rule, pair, NoExcludedArcs());
+}
+
+int Data::countPaths(Rule& rule, pair<int,int>& pair, int maxPaths)
+{
+  return countPathsExcluding(rule, pair, NoExcludedArcs(), maxPaths);
 }
 
 bool Data::hasPath(Rule& rule, pair<int,int>& pair, 
 		   Arc* outArcWithRelation)
 {
-  return hasPathDfs(rule, pair, outArcWithRelation);
+  return hasPathExcluding(rule, pair, ExcludedArc(outArcWithRelation));
+}
+
+// Number of arcs of each relation and, for each pair of sides of the
+// relations, the number of entities in both, from the bitsets of the
+// entities with arcs
+void Data::computeRelationStatistics()
+{
+  int numRelations = (int)relations_.size();
+  int numSides = 2*numRelations;
+  relnumarcs_.assign(numRelations, 0);
+  for(int i=0; i<(int)arcs_.size(); i++)
+    relnumarcs_[arcs_[i]->getIdRelation()]++;
+
+  vector<uint64_t*> sideBits(numSides);
+  for(int r=0; r<numRelations; r++) {
+    sideBits[2*r] = relnodehasarcbits_[r].data();
+    sideBits[2*r+1] = relnodehasinvarcbits_[r].data();
+  }
+  int numWords = ((int)entities_.size()+63)/64;
+  relsideoverlaps_.assign(numSides*numSides, 0);
+#pragma omp parallel for schedule(dynamic)
+  for(int a=0; a<numSides; a++) {
+    for(int b=a; b<numSides; b++) {
+      int overlap = 0;
+      for(int w=0; w<numWords; w++)
+	overlap += __builtin_popcountll(sideBits[a][w] & sideBits[b][w]);
+      relsideoverlaps_[a*numSides + b] = overlap;
+      relsideoverlaps_[b*numSides + a] = overlap;
+    }
+  }
+  relsidesizes_.resize(numSides);
+  for(int a=0; a<numSides; a++)
+    relsidesizes_[a] = relsideoverlaps_[a*numSides + a];
+}
+
+double Data::getAvgOutDegree(int relationId)
+{
+  int numTails = relsidesizes_[2*relationId];
+  return numTails > 0 ? (double)relnumarcs_[relationId]/numTails : 0.0;
+}
+
+double Data::getAvgInDegree(int relationId)
+{
+  int numHeads = relsidesizes_[2*relationId+1];
+  return numHeads > 0 ? (double)relnumarcs_[relationId]/numHeads : 0.0;
 }
 
 bool Data::nodeIsNotInPath(vector<int>& path, int nodeid)
@@ -370,724 +485,798 @@ bool Data::nodeIsNotInPath(vector<vector<pair<int,int> > >& q, int k, int l, int
   return true;
 }
 
-bool Data::depthFirstSearch(Rule& rule, int destid, 
-			    vector<int>& path)
+// A node of the path of walkRuleUsingDFS and the cursor of the scan of
+// its arcs for the next step of the rule
+struct DfsFrame {
+  int nodeid;
+  int relationId;
+  bool useInArcs; // walk the arcs from head to tail
+  int next;       // next arc to scan
+  int numArcs;    // 0 if the node has no arc of the relation
+  Arc* const* arcs;
+};
+
+// Walks the paths of the rule from entityId, forwards (right) or
+// backwards (left), without the arcs excluded by the policy. With
+// entities the entity where each path ends is added to it; otherwise
+// it returns the number of paths that end at destId, as soon as there
+// are maxPaths of them (1 to only know if there is a path). The search
+// is iterative
+// over an explicit stack with a frame for each node of the current
+// path, which is kept per thread and only grows up to the length of the
+// longest rule, so the walks do not allocate.
+template<class Exclusion>
+int Data::walkRuleUsingDFS(Rule& rule, int entityId, bool isLeft,
+			   const Exclusion& exclusion, int destId,
+			   vector<int>* entities, int maxPaths)
 {
   vector<int>& relationIds = rule.getRelationIds();
   vector<bool>& isReverseArc = rule.getIsReverseArc();
+  int rulelength = rule.getLengthRule();
 
-  int lastnodeid = path.back();
-  int pathlength = ((int)path.size())-1;
-
-  if (pathlength == rule.getLengthRule()) {
-    if(lastnodeid == destid)
-      return true;
-    else
-      return false;
-  }
-
-  if(!isReverseArc[pathlength]) {
-    if(relnodehasarc_[relationIds[pathlength]][path.back()]) {
-      vector<Arc*>& arcs = outarcs_[path.back()];
-      for (int i=0; i<(int)arcs.size(); i++) {
-	if(arcs[i]->getIdRelation() == relationIds[pathlength]) {
-	  int newnodeid = arcs[i]->getHead()->getId();
-	  if (nodeIsNotInPath(path,newnodeid)) {
-	    path.push_back(newnodeid);
-	    bool haspath = depthFirstSearch(rule, destid, path);
-	    if (haspath)
-	      return true;
-	    path.pop_back();
-	  }
-	}
-      }
+  static thread_local vector<DfsFrame> frames;
+  if((int)frames.size() < rulelength)
+    frames.resize(rulelength);
+  DfsFrame* stack = frames.data();
+
+  auto enter = [&](int depth, int nodeid) {
+    Profile::count(Profile::DFS_NODES_EXPANDED);
+    DfsFrame& frame = stack[depth];
+    int position = isLeft ? rulelength - depth - 1 : depth;
+    frame.nodeid = nodeid;
+    frame.relationId = relationIds[position];
+    frame.useInArcs = isLeft ? !isReverseArc[position] : isReverseArc[position];
+    frame.next = 0;
+    frame.numArcs = 0;
+    vector<bool>& hasArc = frame.useInArcs ? relnodehasinvarc_[frame.relationId] : relnodehasarc_[frame.relationId];
+    if(hasArc[nodeid]) {
+      vector<Arc*>& arcs = frame.useInArcs ? inarcs_[nodeid] : outarcs_[nodeid];
+      Profile::count(Profile::EDGES_SCANNED, arcs.size());
+      frame.arcs = arcs.data();
+      frame.numArcs = (int)arcs.size();
     }
-  }
-  else {
-    if(relnodehasinvarc_[relationIds[pathlength]][path.back()]) {
-      vector<Arc*>& arcs = inarcs_[path.back()];
-      for (int i=0; i<(int)arcs.size(); i++) {
-	if(arcs[i]->getIdRelation() == relationIds[pathlength]) {
-	  int newnodeid = arcs[i]->getTail()->getId();
-	  if (nodeIsNotInPath(path,newnodeid)) {
-	    path.push_back(newnodeid);
-	    bool haspath = depthFirstSearch(rule, destid, path);
-	    if (haspath)
-	      return true;
-	    path.pop_back();
-	  }
-	}
-      }
+  };
+
+  int numPaths = 0;
+  int depth = 0;
+  enter(0, entityId);
+  while(depth >= 0) {
+    DfsFrame& frame = stack[depth];
+    int i = frame.next;
+    while(i < frame.numArcs &&
+	  (frame.arcs[i]->getIdRelation() != frame.relationId ||
+	   exclusion.isExcluded(frame.arcs[i])))
+      i++;
+    if(i == frame.numArcs) {
+      depth--;
+      continue;
+    }
+    frame.next = i+1;
+    Arc* arc = frame.arcs[i];
+    int newnodeid = frame.useInArcs ? arc->getTail()->getId() : arc->getHead()->getId();
+    if(!repeatedNodesAllowed_) {
+      int d = depth;
+      while(d >= 0 && stack[d].nodeid != newnodeid)
+	d--;
+      if(d >= 0)
+	continue;
     }
+    if(depth+1 == rulelength) {
+      Profile::count(Profile::DFS_NODES_EXPANDED);
+      if(entities)
+	entities->push_back(newnodeid);
+      else if(newnodeid == destId && ++numPaths == maxPaths)
+	return numPaths;
+      continue;
+    }
+    depth++;
+    enter(depth, newnodeid);
   }
 
-  return false;
+  return numPaths;
 }
 
-bool Data::depthFirstSearch(Rule& rule, int destid, 
-			    vector<int>& path, 
-			    Arc* outArcWithRelation)
+// Adds to entities the entity where each path of the rule from
+// entityId ends, walking the rule forwards (right) or backwards (left)
+// level by level, without the arcs excluded by the policy. With
+// repeated nodes the paths are not needed and the frontiers are walked
+// instead.
+template<class Exclusion>
+void Data::walkRuleUsingBFS(Rule& rule, int entityId, bool isLeft,
+			    const Exclusion& exclusion,
+			    vector<int>& entities)
 {
+  if(repeatedNodesAllowed_) {
+    entitiesUsingFrontiers(rule, entityId, isLeft, exclusion, entities);
+    return;
+  }
+
   vector<int>& relationIds = rule.getRelationIds();
   vector<bool>& isReverseArc = rule.getIsReverseArc();
+  int rulelength = rule.getLengthRule();
 
-  int lastnodeid = path.back();
-  int pathlength = ((int)path.size())-1;
-
-  if (pathlength == rule.getLengthRule()) {
-    if(lastnodeid == destid)
-      return true;
-    else
-      return false;
-  }
-
-  if(!isReverseArc[pathlength]) {
-    if(relnodehasarc_[relationIds[pathlength]][path.back()]) {
-      vector<Arc*>& arcs = outarcs_[path.back()];
-      for (int i=0; i<(int)arcs.size(); i++) {
-	if(arcs[i]->getIdRelation() == relationIds[pathlength] &&
-	   arcs[i] != outArcWithRelation) {
-	  int newnodeid = arcs[i]->getHead()->getId();
-	  if (nodeIsNotInPath(path,newnodeid)) {
-	    path.push_back(newnodeid);
-	    bool haspath = depthFirstSearch(rule, destid, path, 
-					    outArcWithRelation);
-	    if (haspath)
-	      return true;
-	    path.pop_back();
-	  }
-	}
-      }
-    }
-  }
-  else {
-    if(relnodehasinvarc_[relationIds[pathlength]][path.back()]) {
-      vector<Arc*>& arcs = inarcs_[path.back()];
+  static thread_local vector<vector<pair<int,int> > > q; // each position corresponds to a level in the search tree. The first int is the nodeId and the second int is the index of the previous node in the path. The levels are kept per thread, so that the walks do not allocate
+  if((int)q.size() < rulelength)
+    q.resize(rulelength);
+  for(int k=0; k<rulelength; k++)
+    q[k].clear();
+  q[0].push_back(pair<int,int>(entityId,-1));
+
+  for(int k=0; k<rulelength; k++) {
+    int position = isLeft ? rulelength - k - 1 : k;
+    int relationId = relationIds[position];
+    bool useInArcs = isLeft ? !isReverseArc[position] : isReverseArc[position]; // walk the arcs from head to tail
+    vector<bool>& hasArc = useInArcs ? relnodehasinvarc_[relationId] : relnodehasarc_[relationId];
+    bool isLastLevel = (k == rulelength-1);
+    for(int l=0; l<(int)q[k].size(); l++) {
+      int nodeid = q[k][l].first;
+      Profile::count(Profile::BFS_NODES_EXPANDED);
+      if(!hasArc[nodeid]) continue;
+      vector<Arc*>& arcs = useInArcs ? inarcs_[nodeid] : outarcs_[nodeid];
+      Profile::count(Profile::EDGES_SCANNED, arcs.size());
       for (int i=0; i<(int)arcs.size(); i++) {
-	if(arcs[i]->getIdRelation() == relationIds[pathlength] &&
-	   arcs[i] != outArcWithRelation) {
-	  int newnodeid = arcs[i]->getTail()->getId();
-	  if (nodeIsNotInPath(path,newnodeid)) {
-	    path.push_back(newnodeid);
-	    bool haspath = depthFirstSearch(rule, destid, path,
-					    outArcWithRelation);
-	    if (haspath)
-	      return true;
-	    path.pop_back();
-	  }
-	}
+	if(arcs[i]->getIdRelation() != relationId || exclusion.isExcluded(arcs[i])) continue;
+	int newnodeid = useInArcs ? arcs[i]->getTail()->getId() : arcs[i]->getHead()->getId();
+	if(!nodeIsNotInPath(q,k,l,newnodeid)) continue;
+	if(isLastLevel)
+	  entities.push_back(newnodeid);
+	else
+	  q[k+1].push_back(pair<int,int>(newnodeid,l));
       }
     }
   }
-
-  return false;
 }
 
-bool Data::hasPathDfs(Rule& rule, pair<int,int>& pair)
-{
-
-  vector<int>& relationIds = rule.getRelationIds();
-  assert(rule.getLengthRule() >= 1);
-
-  int origid = pair.first;
-  int destid = pair.second;
-
-  vector<int> path;
-  path.push_back(origid);
-  
-  bool haspath = depthFirstSearch(rule, destid, path);
-
-  return haspath;
-}
-
- bool Data::hasPathDfs(Rule& rule, pair<int,int>& pair,
-		       Arc* outArcWithRelation)
-{
-
-  vector<int>& relationIds = rule.getRelationIds();
-  assert(rule.getLengthRule() >= 1);
-
-  int origid = pair.first;
-  int destid = pair.second;
-
-  vector<int> path;
-  path.push_back(origid);
-  
-  bool haspath = depthFirstSearch(rule, destid, path, outArcWithRelation);
-
-  return haspath;
-}
-
-void Data::rightEntitiesUsingBFS(Rule& rule, 
-				 int origId,
-				 set<int>& destIds)
+// Adds to entities those reached by the rule from entityId, walking the
+// rule forwards (right) or backwards (left), when repeated nodes are
+// allowed. Without the paths the search only needs the set of entities
+// reached after each step, its frontier, which is kept as a bitset. A
+// small frontier is also kept as a list and expanded top-down from its
+// entities. A frontier with more than 1/16 of the entities is expanded
+// bottom-up: each entity that can be reached with the relation of the
+// step is added if one of its arcs comes from the frontier, stopping at
+// the first one. These candidates are taken a 64 bit word at a time
+// from the bitsets of the entities with arcs of each relation.
+template<class Exclusion>
+void Data::entitiesUsingFrontiers(Rule& rule, int entityId, bool isLeft,
+				  const Exclusion& exclusion,
+				  vector<int>& entities)
 {
   vector<int>& relationIds = rule.getRelationIds();
   vector<bool>& isReverseArc = rule.getIsReverseArc();
   int rulelength = rule.getLengthRule();
-
-  vector<vector<pair<int,int> > > q(rulelength); // each position corresponds to a level in the search tree. The first int is the nodeId and the second int is the index of the previous node in the path
-  q[0].push_back(pair<int,int>(origId,-1));
-
-  for(int k=0; k<rulelength-1; k++) {
-    for(int l=0; l<(int)q[k].size(); l++) {
-      pair<int,int>& p = q[k][l];
-      if(!isReverseArc[k]) {
-	if(relnodehasarc_[relationIds[k]][p.first]) {
-	  vector<Arc*>& arcs = outarcs_[p.first];
-	  for (int i=0; i<(int)arcs.size(); i++) {
-	    if(arcs[i]->getIdRelation() == relationIds[k]) {
-	      int newnodeid = arcs[i]->getHead()->getId();
-	      if (nodeIsNotInPath(q,k,l,newnodeid))
-		q[k+1].push_back(pair<int,int>(newnodeid,l));
-	    }
+  int numNodes = (int)nodes_.size();
+  int numWords = (numNodes+63)/64;
+
+  // kept between calls with all the bits cleared, so that a small
+  // search does not pay for the bitsets of the whole graph
+  static thread_local vector<uint64_t> bits, nextBits;
+  static thread_local vector<int> frontier, next;
+  if((int)bits.size() != numWords) {
+    bits.assign(numWords, 0);
+    nextBits.assign(numWords, 0);
+  }
+  frontier.clear();
+  bits[entityId>>6] |= (uint64_t)1 << (entityId&63);
+  frontier.push_back(entityId);
+  bool isSparse = true; // the list of the frontier is valid, the bits always are
+  long frontierSize = 1;
+
+  for(int k=0; k<rulelength && frontierSize>0; k++) {
+    int position = isLeft ? rulelength - k - 1 : k;
+    int relationId = relationIds[position];
+    bool useInArcs = isLeft ? !isReverseArc[position] : isReverseArc[position]; // walk the arcs from head to tail
+    bool isSparseNext = frontierSize*16 <= numNodes;
+    long nextSize = 0;
+    long edgesScanned = 0;
+    next.clear();
+    if(isSparseNext) { // top-down
+      if(!isSparse) {
+	frontier.clear();
+	for(int w=0; w<numWords; w++)
+	  for(uint64_t word=bits[w]; word; word&=word-1)
+	    frontier.push_back(w*64 + __builtin_ctzll(word));
+      }
+      vector<bool>& hasArc = useInArcs ? relnodehasinvarc_[relationId] : relnodehasarc_[relationId];
+      for(int l=0; l<(int)frontier.size(); l++) {
+	int nodeid = frontier[l];
+	Profile::count(Profile::BFS_NODES_EXPANDED);
+	if(!hasArc[nodeid]) continue;
+	vector<Arc*>& arcs = useInArcs ? inarcs_[nodeid] : outarcs_[nodeid];
+	edgesScanned += arcs.size();
+	for (int i=0; i<(int)arcs.size(); i++) {
+	  if(arcs[i]->getIdRelation() != relationId || exclusion.isExcluded(arcs[i])) continue;
+	  int newnodeid = useInArcs ? arcs[i]->getTail()->getId() : arcs[i]->getHead()->getId();
+	  uint64_t mask = (uint64_t)1 << (newnodeid&63);
+	  if(!(nextBits[newnodeid>>6] & mask)) {
+	    nextBits[newnodeid>>6] |= mask;
+	    next.push_back(newnodeid);
 	  }
 	}
       }
-      else {
-	if(relnodehasinvarc_[relationIds[k]][p.first]) {
-	  vector<Arc*>& arcs = inarcs_[p.first];
+      nextSize = (long)next.size();
+    }
+    else { // bottom-up
+      // a walk forwards ends at an entity with an in arc of the relation
+      vector<uint64_t>& candidates = useInArcs ? relnodehasarcbits_[relationId] : relnodehasinvarcbits_[relationId];
+      for(int w=0; w<numWords; w++) {
+	for(uint64_t word=candidates[w]; word; word&=word-1) {
+	  int nodeid = w*64 + __builtin_ctzll(word);
+	  Profile::count(Profile::BFS_NODES_EXPANDED);
+	  vector<Arc*>& arcs = useInArcs ? outarcs_[nodeid] : inarcs_[nodeid];
 	  for (int i=0; i<(int)arcs.size(); i++) {
-	    if(arcs[i]->getIdRelation() == relationIds[k]) {
-	      int newnodeid = arcs[i]->getTail()->getId();
-	      if (nodeIsNotInPath(q,k,l,newnodeid))
-		q[k+1].push_back(pair<int,int>(newnodeid,l));
+	    edgesScanned++;
+	    if(arcs[i]->getIdRelation() != relationId || exclusion.isExcluded(arcs[i])) continue;
+	    int previd = useInArcs ? arcs[i]->getHead()->getId() : arcs[i]->getTail()->getId();
+	    if((bits[previd>>6] >> (previd&63)) & 1) {
+	      nextBits[w] |= (uint64_t)1 << (nodeid&63);
+	      nextSize++;
+	      break;
 	    }
 	  }
 	}
       }
     }
+    Profile::count(Profile::EDGES_SCANNED, edgesScanned);
+
+    // clear the bits of the frontier, the words of a list hold only its entities
+    if(isSparse) {
+      for(int l=0; l<(int)frontier.size(); l++)
+	bits[frontier[l]>>6] = 0;
+    }
+    else
+      fill(bits.begin(), bits.end(), 0);
+    bits.swap(nextBits);
+    frontier.swap(next);
+    isSparse = isSparseNext;
+    frontierSize = nextSize;
   }
 
-  {
-    int k=rulelength-1;
-    for(int l=0; l<(int)q[k].size(); l++) {
-      pair<int,int>& p = q[k][l];
-      if(!isReverseArc[k]) {
-	if(relnodehasarc_[relationIds[k]][p.first]) {
-	  vector<Arc*>& arcs = outarcs_[p.first];
-	  for (int i=0; i<(int)arcs.size(); i++) {
-	    if(arcs[i]->getIdRelation() == relationIds[k]) {
-	      int newnodeid = arcs[i]->getHead()->getId();
-	      if (nodeIsNotInPath(q,k,l,newnodeid))
-		destIds.insert(newnodeid);
-	    }
-	  }
-	}
-      }
-      else {
-	if(relnodehasinvarc_[relationIds[k]][p.first]) {
-	  vector<Arc*>& arcs = inarcs_[p.first];
-	  for (int i=0; i<(int)arcs.size(); i++) {
-	    if(arcs[i]->getIdRelation() == relationIds[k]) {
-	      int newnodeid = arcs[i]->getTail()->getId();
-	      if (nodeIsNotInPath(q,k,l,newnodeid))
-		destIds.insert(newnodeid);
-	    }
-	  }
-	}
-      }
+  if(isSparse) {
+    entities.insert(entities.end(), frontier.begin(), frontier.end());
+    for(int l=0; l<(int)frontier.size(); l++)
+      bits[frontier[l]>>6] = 0;
+  }
+  else {
+    for(int w=0; w<numWords; w++) {
+      for(uint64_t word=bits[w]; word; word&=word-1)
+	entities.push_back(w*64 + __builtin_ctzll(word));
+      bits[w] = 0;
     }
   }
+}
 
-  return;
+// a + b, saturated at maxCount
+static inline uint32_t addSaturated(uint32_t a, uint32_t b, uint32_t maxCount)
+{
+  uint32_t sum = a + b;
+  if(sum < a || sum > maxCount)
+    sum = maxCount;
+  return sum;
 }
 
-void Data::rightEntitiesUsingDFS(Rule& rule, 
-				 set<int>& destIds, 
-				 vector<int>& path)
+// Number of walks of the rule from entityId to destId, forwards
+// (right) or backwards (left), without the arcs excluded by the policy,
+// up to maxPaths, when repeated nodes are allowed. The walks that reach each entity after a step are counted
+// with a sparse product of the counts of the previous step by the
+// adjacency matrix of the relation of the step, in 32 bit counters that
+// saturate at maxPaths, so they cannot overflow however many walks
+// there are. The entities without an arc for the next step are dropped,
+// and the last step only follows the arcs that end at destId. With
+// destId -1 the last step follows every arc, and the entities reached
+// are added sorted to entities with their number of walks in counts.
+template<class Exclusion>
+int Data::countPathsUsingFrontiers(Rule& rule, int entityId, bool isLeft,
+				   const Exclusion& exclusion, int destId,
+				   int maxPaths, vector<int>* entities,
+				   vector<int>* entityCounts)
 {
   vector<int>& relationIds = rule.getRelationIds();
   vector<bool>& isReverseArc = rule.getIsReverseArc();
-
-  int pathlength = ((int)path.size())-1;
-
-  if (pathlength == rule.getLengthRule()) {
-    int lastnodeid = path.back();
-    destIds.insert(lastnodeid);
-    return;
+  int rulelength = rule.getLengthRule();
+  uint32_t maxCount = (uint32_t)maxPaths;
+
+  // kept between calls with all the counts at 0
+  static thread_local vector<uint32_t> counts, nextCounts;
+  static thread_local vector<int> frontier, next;
+  if(counts.size() != nodes_.size()) {
+    counts.assign(nodes_.size(), 0);
+    nextCounts.assign(nodes_.size(), 0);
   }
-
-  if(!isReverseArc[pathlength]) {
-    if(relnodehasarc_[relationIds[pathlength]][path.back()]) {
-      vector<Arc*>& arcs = outarcs_[path.back()];
+  frontier.clear();
+  frontier.push_back(entityId);
+  counts[entityId] = 1;
+
+  for(int k=0; k<rulelength && !frontier.empty(); k++) {
+    int position = isLeft ? rulelength - k - 1 : k;
+    int relationId = relationIds[position];
+    bool useInArcs = isLeft ? !isReverseArc[position] : isReverseArc[position]; // walk the arcs from head to tail
+    vector<bool>& hasArc = useInArcs ? relnodehasinvarc_[relationId] : relnodehasarc_[relationId];
+    bool isLastStep = (k == rulelength-1);
+    long edgesScanned = 0;
+    next.clear();
+    for(int l=0; l<(int)frontier.size(); l++) {
+      int nodeid = frontier[l];
+      uint32_t count = counts[nodeid];
+      counts[nodeid] = 0;
+      Profile::count(Profile::BFS_NODES_EXPANDED);
+      if(!hasArc[nodeid]) continue;
+      vector<Arc*>& arcs = useInArcs ? inarcs_[nodeid] : outarcs_[nodeid];
+      edgesScanned += arcs.size();
       for (int i=0; i<(int)arcs.size(); i++) {
-	if(arcs[i]->getIdRelation() == relationIds[pathlength]) {
-	  int newnodeid = arcs[i]->getHead()->getId();
-	  if (nodeIsNotInPath(path,newnodeid)) {
-	    path.push_back(newnodeid);
-	    rightEntitiesUsingDFS(rule, destIds, path);
-	    path.pop_back();
-	  }
-	}
+	if(arcs[i]->getIdRelation() != relationId || exclusion.isExcluded(arcs[i])) continue;
+	int newnodeid = useInArcs ? arcs[i]->getTail()->getId() : arcs[i]->getHead()->getId();
+	if(isLastStep && destId >= 0 && newnodeid != destId) continue;
+	if(nextCounts[newnodeid] == 0)
+	  next.push_back(newnodeid);
+	nextCounts[newnodeid] = addSaturated(nextCounts[newnodeid], count, maxCount);
       }
     }
+    Profile::count(Profile::EDGES_SCANNED, edgesScanned);
+    counts.swap(nextCounts);
+    frontier.swap(next);
   }
-  else {
-    if(relnodehasinvarc_[relationIds[pathlength]][path.back()]) {
-      vector<Arc*>& arcs = inarcs_[path.back()];
-      for (int i=0; i<(int)arcs.size(); i++) {
-	if(arcs[i]->getIdRelation() == relationIds[pathlength]) {
-	  int newnodeid = arcs[i]->getTail()->getId();
-	  if (nodeIsNotInPath(path,newnodeid)) {
-	    path.push_back(newnodeid);
-	    rightEntitiesUsingDFS(rule, destIds, path);
-	    path.pop_back();
-	  }
-	}
-      }
+
+  if(entities) {
+    sort(frontier.begin(), frontier.end());
+    for(int l=0; l<(int)frontier.size(); l++) {
+      entities->push_back(frontier[l]);
+      entityCounts->push_back((int)counts[frontier[l]]);
     }
   }
 
-  return;
-}
-
-void Data::getRightEntities(Rule& rule, int origId, 
-			    set<int>& destIds, bool useBFS)
-{
-  assert(rule.getLengthRule() >= 1);
-  if(useBFS)
-    rightEntitiesUsingBFS(rule, origId, destIds);
-  else {
-    vector<int> path;
-    path.push_back(origId);
-    rightEntitiesUsingDFS(rule, destIds, path);
+  // only destId can be left after the last step, unless a step had no arcs
+  int numPaths = 0;
+  for(int l=0; l<(int)frontier.size(); l++) {
+    if(frontier[l] == destId)
+      numPaths = (int)counts[destId];
+    counts[frontier[l]] = 0;
   }
+  return numPaths;
 }
 
-void Data::leftEntitiesUsingBFS(Rule& rule, 
-				int destId,
-				set<int>& origIds)
+// Cost of expanding an entity of a frontier relative to a node of the
+// depth first walk, for the bitsets and the bottom-up steps
+static const double FRONTIER_NODE_COST = 2.0;
+
+// Expected number of nodes expanded by the depth first walk of the
+// rule from entityId, forwards (right) or backwards (left), and in
+// frontierNodes by the walk of its frontiers. Whether the entity has an
+// arc for the first step is known. The paths that reach a later step
+// continue from the fraction of the entities of the side where the
+// previous step ends that are also in the side where this one starts,
+// and each continues through the average degree of the relation on
+// that side. A frontier has at most the entities of the side where its
+// step ends.
+double Data::estimateWalk(Rule& rule, int entityId, bool isLeft,
+			  double& frontierNodes)
 {
   vector<int>& relationIds = rule.getRelationIds();
   vector<bool>& isReverseArc = rule.getIsReverseArc();
   int rulelength = rule.getLengthRule();
-
-  vector<vector<pair<int,int> > > q(rulelength); // each position corresponds to a level in the search tree. The first int is the nodeId and the second int is the index of the previous node in the path
-  q[0].push_back(pair<int,int>(destId,-1));
-
-  for(int k=0; k<rulelength-1; k++) {
-    int position = rulelength - k - 1;
-    for(int l=0; l<(int)q[k].size(); l++) {
-      pair<int,int>& p = q[k][l];
-      if(!isReverseArc[position]) {
-	if(relnodehasinvarc_[relationIds[position]][p.first]) {
-	  vector<Arc*>& arcs = inarcs_[p.first];
-	  for (int i=0; i<(int)arcs.size(); i++) {
-	    if(arcs[i]->getIdRelation() == relationIds[position]) {
-	      int newnodeid = arcs[i]->getTail()->getId();
-	      if (nodeIsNotInPath(q,k,l,newnodeid))
-		q[k+1].push_back(pair<int,int>(newnodeid,l));
-	    }
-	  }
-	}
-      }
-      else {
-	if(relnodehasarc_[relationIds[position]][p.first]) {
-	  vector<Arc*>& arcs = outarcs_[p.first];
-	  for (int i=0; i<(int)arcs.size(); i++) {
-	    if(arcs[i]->getIdRelation() == relationIds[position]) {
-	      int newnodeid = arcs[i]->getHead()->getId();
-	      if (nodeIsNotInPath(q,k,l,newnodeid))
-		q[k+1].push_back(pair<int,int>(newnodeid,l));
-	    }
-	  }
-	}
-      }
+  int numSides = 2*(int)relations_.size();
+
+  double paths = 1.0; // paths that reach the current step
+  double frontier = 1.0;
+  double nodes = 1.0;
+  frontierNodes = 1.0;
+  int prevSide = -1;
+  for(int k=0; k<rulelength; k++) {
+    int position = isLeft ? rulelength - k - 1 : k;
+    int relationId = relationIds[position];
+    bool useInArcs = isLeft ? !isReverseArc[position] : isReverseArc[position];
+    int side = 2*relationId + (useInArcs ? 1 : 0); // where the step starts
+    double fraction;
+    if(k == 0) {
+      vector<bool>& hasArc = useInArcs ? relnodehasinvarc_[relationId] : relnodehasarc_[relationId];
+      fraction = hasArc[entityId] ? 1.0 : 0.0;
     }
+    else
+      fraction = relsidesizes_[prevSide] > 0 ? (double)relsideoverlaps_[prevSide*numSides + side]/relsidesizes_[prevSide] : 0.0;
+    double degree = useInArcs ? getAvgInDegree(relationId) : getAvgOutDegree(relationId);
+    prevSide = side ^ 1;
+    paths *= fraction*degree;
+    frontier = min(frontier*fraction*degree, (double)relsidesizes_[prevSide]);
+    nodes += paths;
+    frontierNodes += frontier;
+  }
+  return nodes;
+}
+
+// Whether the entities reached by the rule from entityId are cheaper to
+// find walking its frontiers than depth first, with the estimated nodes
+// of the chosen walk. Without repeated nodes both walks expand every
+// path, and the depth first one is chosen because it only keeps the
+// current path.
+bool Data::planUseBFS(Rule& rule, int entityId, bool isLeft, double& estimate)
+{
+  double frontierNodes;
+  estimate = estimateWalk(rule, entityId, isLeft, frontierNodes);
+  if(repeatedNodesAllowed_ && FRONTIER_NODE_COST*frontierNodes < estimate) {
+    estimate = frontierNodes;
+    return true;
   }
+  return false;
+}
+
+// Whether the paths of the rule between the entities of the pair are
+// cheaper to walk backwards from the second than forwards from the
+// first, depth first or by their frontiers, with the estimated nodes of
+// the chosen direction
+bool Data::planIsLeft(Rule& rule, pair<int,int>& pair, bool useFrontiers,
+		      double& estimate)
+{
+  double frontierNodes[2];
+  double dfsNodes[2];
+  dfsNodes[0] = estimateWalk(rule, pair.first, false, frontierNodes[0]);
+  dfsNodes[1] = estimateWalk(rule, pair.second, true, frontierNodes[1]);
+  double* nodes = useFrontiers ? frontierNodes : dfsNodes;
+  bool isLeft = nodes[1] < nodes[0];
+  estimate = nodes[isLeft ? 1 : 0];
+  return isLeft;
+}
+
+// Adds to the profile a walk chosen by the planner, its estimated nodes
+// and, when it goes out of scope, the nodes it expanded, so that the
+// estimates can be compared with the work to tune the cost model
+class PlannedWalk {
+private:
+  bool isStarted_;
+  long long start_;
 
+  static long long getNodesExpanded()
+  {return Profile::getLocalCounter(Profile::DFS_NODES_EXPANDED) + Profile::getLocalCounter(Profile::BFS_NODES_EXPANDED);}
+
+public:
+  PlannedWalk():isStarted_(false),start_(0) {}
+  ~PlannedWalk()
   {
-    int k=rulelength-1;
-    int position = rulelength - k - 1;
-    for(int l=0; l<(int)q[k].size(); l++) {
-      pair<int,int>& p = q[k][l];
-      if(!isReverseArc[position]) {
-	if(relnodehasinvarc_[relationIds[position]][p.first]) {
-	  vector<Arc*>& arcs = inarcs_[p.first];
-	  for (int i=0; i<(int)arcs.size(); i++) {
-	    if(arcs[i]->getIdRelation() == relationIds[position]) {
-	      int newnodeid = arcs[i]->getTail()->getId();
-	      if (nodeIsNotInPath(q,k,l,newnodeid))
-		origIds.insert(newnodeid);
-	    }
-	  }
-	}
-      }
-      else {
-	if(relnodehasarc_[relationIds[position]][p.first]) {
-	  vector<Arc*>& arcs = outarcs_[p.first];
-	  for (int i=0; i<(int)arcs.size(); i++) {
-	    if(arcs[i]->getIdRelation() == relationIds[position]) {
-	      int newnodeid = arcs[i]->getHead()->getId();
-	      if (nodeIsNotInPath(q,k,l,newnodeid))
-		origIds.insert(newnodeid);
-	    }
-	  }
-	}
-      }
-    }
+    if(isStarted_)
+      Profile::count(Profile::PLANNED_NODES_EXPANDED, getNodesExpanded() - start_);
   }
 
-  return;
+  void start(double estimate)
+  {
+    Profile::count(Profile::PLANNED_WALKS);
+    Profile::count(Profile::PLANNED_NODES_ESTIMATED, (long long)min(estimate, 1.0e15));
+    isStarted_ = true;
+    start_ = getNodesExpanded();
+  }
+};
+
+// Entities reached by the rule from entityId, forwards (right) or
+// backwards (left), sorted and without repetitions. With the planner
+// the search is chosen for the rule and the entity instead of useBFS.
+template<class Exclusion>
+void Data::getEntitiesExcluding(Rule& rule, int entityId, bool isLeft,
+				const Exclusion& exclusion,
+				vector<int>& entities, bool useBFS)
+{
+  Profile::count(Profile::RULES_EVALUATED);
+  assert(rule.getLengthRule() >= 1);
+  PlannedWalk planned;
+  if(planRuleWalks_) {
+    double estimate;
+    useBFS = planUseBFS(rule, entityId, isLeft, estimate);
+    planned.start(estimate);
+    if(useBFS)
+      Profile::count(Profile::PLANNED_BFS_WALKS);
+  }
+  entities.clear();
+  if(useBFS)
+    walkRuleUsingBFS(rule, entityId, isLeft, exclusion, entities);
+  else
+    walkRuleUsingDFS(rule, entityId, isLeft, exclusion, -1, &entities);
+  sort(entities.begin(), entities.end());
+  entities.erase(unique(entities.begin(), entities.end()), entities.end());
 }
 
-void Data::leftEntitiesUsingDFS(Rule& rule, 
-				set<int>& origIds, 
-				vector<int>& path)
+// Whether the rule has a path from the first entity of the pair to the
+// second. It is searched depth first from the first entity, or with the
+// planner from the end with the smaller estimated walk.
+template<class Exclusion>
+bool Data::hasPathExcluding(Rule& rule, pair<int,int>& pair,
+			    const Exclusion& exclusion)
 {
-  vector<int>& relationIds = rule.getRelationIds();
-  vector<bool>& isReverseArc = rule.getIsReverseArc();
+  Profile::count(Profile::RULES_EVALUATED);
+  assert(rule.getLengthRule() >= 1);
+  bool isLeft = false;
+  PlannedWalk planned;
+  if(planRuleWalks_) {
+    double estimate;
+    isLeft = planIsLeft(rule, pair, false, estimate);
+    planned.start(estimate);
+    if(isLeft)
+      Profile::count(Profile::PLANNED_BACKWARD_WALKS);
+  }
+  if(isLeft)
+    return walkRuleUsingDFS(rule, pair.second, true, exclusion, pair.first, NULL);
+  return walkRuleUsingDFS(rule, pair.first, false, exclusion, pair.second, NULL);
+}
 
-  int pathlength = ((int)path.size())-1;
+// Number of paths of the rule from the first entity of the pair to the
+// second, up to maxPaths. Without repeated nodes they are enumerated
+// depth first, which stops at maxPaths. As in hasPathExcluding, the
+// planner may walk them backwards from the second entity.
+template<class Exclusion>
+int Data::countPathsExcluding(Rule& rule, pair<int,int>& pair,
+			      const Exclusion& exclusion, int maxPaths)
+{
+  Profile::count(Profile::RULES_EVALUATED);
+  assert(rule.getLengthRule() >= 1);
+  bool isLeft = false;
+  PlannedWalk planned;
+  if(planRuleWalks_) {
+    double estimate;
+    isLeft = planIsLeft(rule, pair, repeatedNodesAllowed_, estimate);
+    planned.start(estimate);
+    if(isLeft)
+      Profile::count(Profile::PLANNED_BACKWARD_WALKS);
+  }
+  int entityId = isLeft ? pair.second : pair.first;
+  int destId = isLeft ? pair.first : pair.second;
+  if(repeatedNodesAllowed_)
+    return countPathsUsingFrontiers(rule, entityId, isLeft, exclusion, destId, maxPaths);
+  return walkRuleUsingDFS(rule, entityId, isLeft, exclusion, destId, NULL, maxPaths);
+}
 
-  if (pathlength == rule.getLengthRule()) {
-    int lastnodeid = path.back();
-    origIds.insert(lastnodeid);
+// Entities reached by the rule from entityId, forwards (right) or
+// backwards (left), sorted and without repetitions, with the number of
+// paths that reach each of them up to maxPaths in counts. Without
+// repeated nodes the paths are enumerated depth first and the entities
+// where they end are counted after sorting them.
+template<class Exclusion>
+void Data::getEntityPathCountsExcluding(Rule& rule, int entityId,
+					bool isLeft,
+					const Exclusion& exclusion,
+					int maxPaths, vector<int>& entities,
+					vector<int>& counts)
+{
+  Profile::count(Profile::RULES_EVALUATED);
+  assert(rule.getLengthRule() >= 1);
+  entities.clear();
+  counts.clear();
+  if(repeatedNodesAllowed_) {
+    countPathsUsingFrontiers(rule, entityId, isLeft, exclusion, -1, maxPaths, &entities, &counts);
     return;
   }
 
-  int position = rule.getLengthRule() - pathlength - 1;
-  if(!isReverseArc[position]) {
-    if(relnodehasinvarc_[relationIds[position]][path.back()]) {
-      vector<Arc*>& arcs = inarcs_[path.back()];
-      for (int i=0; i<(int)arcs.size(); i++) {
-	if(arcs[i]->getIdRelation() == relationIds[position]) {
-	  int newnodeid = arcs[i]->getTail()->getId();
-	  if (nodeIsNotInPath(path,newnodeid)) {
-	    path.push_back(newnodeid);
-	    leftEntitiesUsingDFS(rule, origIds, path);
-	    path.pop_back();
-	  }
-	}
-      }
-    }
-  }
-  else {
-    if(relnodehasarc_[relationIds[position]][path.back()]) {
-      vector<Arc*>& arcs = outarcs_[path.back()];
-      for (int i=0; i<(int)arcs.size(); i++) {
-	if(arcs[i]->getIdRelation() == relationIds[position]) {
-	  int newnodeid = arcs[i]->getHead()->getId();
-	  if (nodeIsNotInPath(path,newnodeid)) {
-	    path.push_back(newnodeid);
-	    leftEntitiesUsingDFS(rule, origIds, path);
-	    path.pop_back();
-	  }
-	}
-      }
-    }
+  static thread_local vector<int> ends;
+  ends.clear();
+  walkRuleUsingDFS(rule, entityId, isLeft, exclusion, -1, &ends);
+  sort(ends.begin(), ends.end());
+  for(int l=0; l<(int)ends.size(); ) {
+    int m = l+1;
+    while(m < (int)ends.size() && ends[m] == ends[l])
+      m++;
+    entities.push_back(ends[l]);
+    counts.push_back(min(m-l, maxPaths));
+    l = m;
   }
+}
+
+void Data::getEntityPathCounts(Rule& rule, int entityId, bool isLeft,
+			       int maxPaths, vector<int>& entities,
+			       vector<int>& counts)
+{
+  getEntityPathCountsExcluding(rule, entityId, isLeft, NoExcludedArcs(), maxPaths, entities, counts);
+}
 
-  return;
+// the walks are instantiated here for each policy, so that their code
+// stays in this file
+#define INSTANTIATE_RULE_WALKS(Exclusion) \
+  template int Data::walkRuleUsingDFS<Exclusion>(Rule&, int, bool, const Exclusion&, int, vector<int>*, int); \
+  template void Data::walkRuleUsingBFS<Exclusion>(Rule&, int, bool, const Exclusion&, vector<int>&); \
+  template void Data::getEntitiesExcluding<Exclusion>(Rule&, int, bool, const Exclusion&, vector<int>&, bool); \
+  template bool Data::hasPathExcluding<Exclusion>(Rule&, pair<int,int>&, const Exclusion&); \
+  template int Data::countPathsExcluding<Exclusion>(Rule&, pair<int,int>&, const Exclusion&, int); \
+  template void Data::getEntityPathCountsExcluding<Exclusion>(Rule&, int, bool, const Exclusion&, int, vector<int>&, vector<int>&);
+INSTANTIATE_RULE_WALKS(NoExcludedArcs)
+INSTANTIATE_RULE_WALKS(ExcludedArc)
+#undef INSTANTIATE_RULE_WALKS
+
+bool Data::depthFirstSearch(Rule& rule, int origid, int destid)
+{
+  return walkRuleUsingDFS(rule, origid, false, NoExcludedArcs(), destid, NULL);
 }
 
-void Data::getLeftEntities(Rule& rule, int destId, 
-			   set<int>& origIds, bool useBFS)
+bool Data::depthFirstSearch(Rule& rule, int origid, int destid,
+			    Arc* outArcWithRelation)
+{
+  return walkRuleUsingDFS(rule, origid, false, ExcludedArc(outArcWithRelation), destid, NULL);
+}
+
+bool Data::hasPathDfs(Rule& rule, pair<int,int>& pair)
 {
   assert(rule.getLengthRule() >= 1);
-  if(useBFS)
-    leftEntitiesUsingBFS(rule, destId, origIds);
-  else {
-    vector<int> path;
-    path.push_back(destId);
-    leftEntitiesUsingDFS(rule, origIds, path);
-  }
+  return depthFirstSearch(rule, pair.first, pair.second);
 }
 
-void Data::rightEntitiesUsingBFS(Arc* outArcWithRelation,
-				 Rule& rule, 
+bool Data::hasPathDfs(Rule& rule, pair<int,int>& pair,
+		      Arc* outArcWithRelation)
+{
+  assert(rule.getLengthRule() >= 1);
+  return depthFirstSearch(rule, pair.first, pair.second, outArcWithRelation);
+}
+
+void Data::rightEntitiesUsingBFS(Rule& rule, 
 				 int origId,
-				 set<int>& destIds)
+				 vector<int>& destIds)
 {
-  vector<int>& relationIds = rule.getRelationIds();
-  vector<bool>& isReverseArc = rule.getIsReverseArc();
-  int rulelength = rule.getLengthRule();
+  walkRuleUsingBFS(rule, origId, false, NoExcludedArcs(), destIds);
+}
 
-  vector<vector<pair<int,int> > > q(rulelength); // each position corresponds to a level in the search tree. The first int is the nodeId and the second int is the index of the previous node in the path
-  q[0].push_back(pair<int,int>(origId,-1));
+void Data::rightEntitiesUsingDFS(Rule& rule, 
+				 int origId,
+				 vector<int>& destIds)
+{
+  walkRuleUsingDFS(rule, origId, false, NoExcludedArcs(), -1, &destIds);
+}
 
-  for(int k=0; k<rulelength-1; k++) {
-    for(int l=0; l<(int)q[k].size(); l++) {
-      pair<int,int>& p = q[k][l];
-      if(!isReverseArc[k]) {
-	if(relnodehasarc_[relationIds[k]][p.first]) {
-	  vector<Arc*>& arcs = outarcs_[p.first];
-	  for (int i=0; i<(int)arcs.size(); i++) {
-	    if(arcs[i]->getIdRelation() == relationIds[k] &&
-	       arcs[i] != outArcWithRelation) {
-	      int newnodeid = arcs[i]->getHead()->getId();
-	      if (nodeIsNotInPath(q,k,l,newnodeid))
-		q[k+1].push_back(pair<int,int>(newnodeid,l));
-	    }
-	  }
-	}
-      }
-      else {
-	if(relnodehasinvarc_[relationIds[k]][p.first]) {
-	  vector<Arc*>& arcs = inarcs_[p.first];
-	  for (int i=0; i<(int)arcs.size(); i++) {
-	    if(arcs[i]->getIdRelation() == relationIds[k] &&
-	       arcs[i] != outArcWithRelation) {
-	      int newnodeid = arcs[i]->getTail()->getId();
-	      if (nodeIsNotInPath(q,k,l,newnodeid))
-		q[k+1].push_back(pair<int,int>(newnodeid,l));
-	    }
-	  }
-	}
-      }
-    }
-  }
+void Data::getRightEntities(Rule& rule, int origId, 
+			    set<int>& destIds, bool useBFS)
+{
+  vector<int> ids;
+  getRightEntities(rule, origId, ids, useBFS);
+  destIds.insert(ids.begin(), ids.end());
+}
 
-  {
-    int k=rulelength-1;
-    for(int l=0; l<(int)q[k].size(); l++) {
-      pair<int,int>& p = q[k][l];
-      if(!isReverseArc[k]) {
-	if(relnodehasarc_[relationIds[k]][p.first]) {
-	  vector<Arc*>& arcs = outarcs_[p.first];
-	  for (int i=0; i<(int)arcs.size(); i++) {
-	    if(arcs[i]->getIdRelation() == relationIds[k] &&
-	       arcs[i] != outArcWithRelation) {
-	      int newnodeid = arcs[i]->getHead()->getId();
-	      if (nodeIsNotInPath(q,k,l,newnodeid))
-		destIds.insert(newnodeid);
-	    }
-	  }
-	}
-      }
-      else {
-	if(relnodehasinvarc_[relationIds[k]][p.first]) {
-	  vector<Arc*>& arcs = inarcs_[p.first];
-	  for (int i=0; i<(int)arcs.size(); i++) {
-	    if(arcs[i]->getIdRelation() == relationIds[k] &&
-	       arcs[i] != outArcWithRelation) {
-	      int newnodeid = arcs[i]->getTail()->getId();
-	      if (nodeIsNotInPath(q,k,l,newnodeid))
-		destIds.insert(newnodeid);
-	    }
-	  }
-	}
-      }
-    }
-  }
+// The destinations sorted and without repetitions
+void Data::getRightEntities(Rule& rule, int origId, 
+			    vector<int>& destIds, bool useBFS)
+{
+  getEntitiesExcluding(rule, origId, false, NoExcludedArcs(), destIds, useBFS);
+}
 
-  return;
+void Data::leftEntitiesUsingBFS(Rule& rule, 
+				int destId,
+				vector<int>& origIds)
+{
+  walkRuleUsingBFS(rule, destId, true, NoExcludedArcs(), origIds);
 }
 
-void Data::rightEntitiesUsingDFS(Arc* outArcWithRelation,
-				 Rule& rule, 
-				 set<int>& destIds, 
-				 vector<int>& path)
+void Data::leftEntitiesUsingDFS(Rule& rule, 
+				int destId,
+				vector<int>& origIds)
 {
-  vector<int>& relationIds = rule.getRelationIds();
-  vector<bool>& isReverseArc = rule.getIsReverseArc();
+  walkRuleUsingDFS(rule, destId, true, NoExcludedArcs(), -1, &origIds);
+}
 
-  int pathlength = ((int)path.size())-1;
+void Data::getLeftEntities(Rule& rule, int destId, 
+			   set<int>& origIds, bool useBFS)
+{
+  vector<int> ids;
+  getLeftEntities(rule, destId, ids, useBFS);
+  origIds.insert(ids.begin(), ids.end());
+}
 
-  if (pathlength == rule.getLengthRule()) {
-    int lastnodeid = path.back();
-    destIds.insert(lastnodeid);
-    return;
+// The origins sorted and without repetitions
+void Data::getLeftEntities(Rule& rule, int destId, 
+			   vector<int>& origIds, bool useBFS)
+{
+  getEntitiesExcluding(rule, destId, true, NoExcludedArcs(), origIds, useBFS);
+}
+
+// Entities reached from entityId by every rule of the trie, sorted and
+// without repetitions. touchedRules gets the rules that reach some
+// entity; the caller clears their entities before the next call.
+void Data::getEntitiesOfRules(RuleTrie& trie, int entityId,
+			      vector<vector<int> >& entities,
+			      vector<int>& touchedRules)
+{
+  touchedRules.clear();
+  vector<int> path;
+  path.push_back(entityId);
+  walkRuleTrie(trie, 0, path, entities, touchedRules);
+  for(int i=0; i<(int)touchedRules.size(); i++) {
+    vector<int>& ids = entities[touchedRules[i]];
+    sort(ids.begin(), ids.end());
+    ids.erase(unique(ids.begin(), ids.end()), ids.end());
   }
+}
 
-  if(!isReverseArc[pathlength]) {
-    if(relnodehasarc_[relationIds[pathlength]][path.back()]) {
-      vector<Arc*>& arcs = outarcs_[path.back()];
-      for (int i=0; i<(int)arcs.size(); i++) {
-	if(arcs[i]->getIdRelation() == relationIds[pathlength] &&
-	   arcs[i] != outArcWithRelation) {
-	  int newnodeid = arcs[i]->getHead()->getId();
-	  if (nodeIsNotInPath(path,newnodeid)) {
-	    path.push_back(newnodeid);
-	    rightEntitiesUsingDFS(outArcWithRelation, rule, destIds, path);
-	    path.pop_back();
-	  }
-	}
-      }
+void Data::walkRuleTrie(RuleTrie& trie, int node, vector<int>& path,
+			vector<vector<int> >& entities,
+			vector<int>& touchedRules)
+{
+  Profile::count(Profile::DFS_NODES_EXPANDED);
+  int lastnodeid = path.back();
+  vector<RuleTrie::Edge>& edges = trie.getEdges(node);
+  for(int e=0; e<(int)edges.size(); e++) {
+    RuleTrie::Edge& edge = edges[e];
+    if(edge.useInArcs) {
+      if(!relnodehasinvarc_[edge.relationId][lastnodeid]) continue;
     }
-  }
-  else {
-    if(relnodehasinvarc_[relationIds[pathlength]][path.back()]) {
-      vector<Arc*>& arcs = inarcs_[path.back()];
-      for (int i=0; i<(int)arcs.size(); i++) {
-	if(arcs[i]->getIdRelation() == relationIds[pathlength] &&
-	   arcs[i] != outArcWithRelation) {
-	  int newnodeid = arcs[i]->getTail()->getId();
-	  if (nodeIsNotInPath(path,newnodeid)) {
-	    path.push_back(newnodeid);
-	    rightEntitiesUsingDFS(outArcWithRelation, rule, destIds, path);
-	    path.pop_back();
-	  }
-	}
+    else {
+      if(!relnodehasarc_[edge.relationId][lastnodeid]) continue;
+    }
+    vector<Arc*>& arcs = edge.useInArcs ? inarcs_[lastnodeid] : outarcs_[lastnodeid];
+    vector<int>& endingRules = trie.getRules(edge.child);
+    bool hasChildren = !trie.getEdges(edge.child).empty();
+    Profile::count(Profile::EDGES_SCANNED, arcs.size());
+    for (int i=0; i<(int)arcs.size(); i++) {
+      if(arcs[i]->getIdRelation() != edge.relationId) continue;
+      int newnodeid = edge.useInArcs ? arcs[i]->getTail()->getId() : arcs[i]->getHead()->getId();
+      if(!nodeIsNotInPath(path,newnodeid)) continue;
+      for(int r=0; r<(int)endingRules.size(); r++) {
+	vector<int>& ids = entities[endingRules[r]];
+	if(ids.empty())
+	  touchedRules.push_back(endingRules[r]);
+	ids.push_back(newnodeid);
+      }
+      if(hasChildren) {
+	path.push_back(newnodeid);
+	walkRuleTrie(trie, edge.child, path, entities, touchedRules);
+	path.pop_back();
       }
     }
   }
+}
+
+void Data::rightEntitiesUsingBFS(Arc* outArcWithRelation,
+				 Rule& rule, 
+				 int origId,
+				 vector<int>& destIds)
+{
+  walkRuleUsingBFS(rule, origId, false, ExcludedArc(outArcWithRelation), destIds);
+}
 
-  return;
+void Data::rightEntitiesUsingDFS(Arc* outArcWithRelation,
+				 Rule& rule, 
+				 int origId,
+				 vector<int>& destIds)
+{
+  walkRuleUsingDFS(rule, origId, false, ExcludedArc(outArcWithRelation), -1, &destIds);
 }
 
 void Data::getRightEntities(Arc* outArcWithRelation, Rule& rule, 
 			    int origId, set<int>& destIds,
 			    bool useBFS)
 {
-  assert(rule.getLengthRule() >= 1);
-  if(useBFS)
-    rightEntitiesUsingBFS(outArcWithRelation, rule, origId, destIds);
-  else {
-    vector<int> path;
-    path.push_back(origId);
-    rightEntitiesUsingDFS(outArcWithRelation, rule, destIds, path);
-  }
+  vector<int> ids;
+  getRightEntities(outArcWithRelation, rule, origId, ids, useBFS);
+  destIds.insert(ids.begin(), ids.end());
+}
+
+// The destinations sorted and without repetitions
+void Data::getRightEntities(Arc* outArcWithRelation, Rule& rule, 
+			    int origId, vector<int>& destIds,
+			    bool useBFS)
+{
+  getEntitiesExcluding(rule, origId, false, ExcludedArc(outArcWithRelation), destIds, useBFS);
 }
 
 void Data::leftEntitiesUsingBFS(Arc* outArcWithRelation,
 				Rule& rule, 
 				int destId,
-				set<int>& origIds)
+				vector<int>& origIds)
 {
-  vector<int>& relationIds = rule.getRelationIds();
-  vector<bool>& isReverseArc = rule.getIsReverseArc();
-  int rulelength = rule.getLengthRule();
-
-  vector<vector<pair<int,int> > > q(rulelength); // each position corresponds to a level in the search tree. The first int is the nodeId and the second int is the index of the previous node in the path
-  q[0].push_back(pair<int,int>(destId,-1));
-
-  for(int k=0; k<rulelength-1; k++) {
-    int position = rulelength - k - 1;
-    for(int l=0; l<(int)q[k].size(); l++) {
-      pair<int,int>& p = q[k][l];
-      if(!isReverseArc[position]) {
-	if(relnodehasinvarc_[relationIds[position]][p.first]) {
-	  vector<Arc*>& arcs = inarcs_[p.first];
-	  for (int i=0; i<(int)arcs.size(); i++) {
-	    if(arcs[i]->getIdRelation() == relationIds[position] &&
-	       arcs[i] != outArcWithRelation) {
-	      int newnodeid = arcs[i]->getTail()->getId();
-	      if (nodeIsNotInPath(q,k,l,newnodeid))
-		q[k+1].push_back(pair<int,int>(newnodeid,l));
-	    }
-	  }
-	}
-      }
-      else {
-	if(relnodehasarc_[relationIds[position]][p.first]) {
-	  vector<Arc*>& arcs = outarcs_[p.first];
-	  for (int i=0; i<(int)arcs.size(); i++) {
-	    if(arcs[i]->getIdRelation() == relationIds[position] &&
-	       arcs[i] != outArcWithRelation) {
-	      int newnodeid = arcs[i]->getHead()->getId();
-	      if (nodeIsNotInPath(q,k,l,newnodeid))
-		q[k+1].push_back(pair<int,int>(newnodeid,l));
-	    }
-	  }
-	}
-      }
-    }
-  }
-
-  {
-    int k=rulelength-1;
-    int position = rulelength - k - 1;
-    for(int l=0; l<(int)q[k].size(); l++) {
-      pair<int,int>& p = q[k][l];
-      if(!isReverseArc[position]) {
-	if(relnodehasinvarc_[relationIds[position]][p.first]) {
-	  vector<Arc*>& arcs = inarcs_[p.first];
-	  for (int i=0; i<(int)arcs.size(); i++) {
-	    if(arcs[i]->getIdRelation() == relationIds[position] &&
-	       arcs[i] != outArcWithRelation) {
-	      int newnodeid = arcs[i]->getTail()->getId();
-	      if (nodeIsNotInPath(q,k,l,newnodeid))
-		origIds.insert(newnodeid);
-	    }
-	  }
-	}
-      }
-      else {
-	if(relnodehasarc_[relationIds[position]][p.first]) {
-	  vector<Arc*>& arcs = outarcs_[p.first];
-	  for (int i=0; i<(int)arcs.size(); i++) {
-	    if(arcs[i]->getIdRelation() == relationIds[position] &&
-	       arcs[i] != outArcWithRelation) {
-	      int newnodeid = arcs[i]->getHead()->getId();
-	      if (nodeIsNotInPath(q,k,l,newnodeid))
-		origIds.insert(newnodeid);
-	    }
-	  }
-	}
-      }
-    }
-  }
-
-  return;
+  walkRuleUsingBFS(rule, destId, true, ExcludedArc(outArcWithRelation), origIds);
 }
 
 void Data::leftEntitiesUsingDFS(Arc* outArcWithRelation,
 				Rule& rule, 
-				set<int>& origIds, 
-				vector<int>& path)
+				int destId,
+				vector<int>& origIds)
 {
-  vector<int>& relationIds = rule.getRelationIds();
-  vector<bool>& isReverseArc = rule.getIsReverseArc();
-
-  int pathlength = ((int)path.size())-1;
-
-  if (pathlength == rule.getLengthRule()) {
-    int lastnodeid = path.back();
-    origIds.insert(lastnodeid);
-    return;
-  }
-
-  int position = rule.getLengthRule() - pathlength - 1;
-  if(!isReverseArc[position]) {
-    if(relnodehasinvarc_[relationIds[position]][path.back()]) {
-      vector<Arc*>& arcs = inarcs_[path.back()];
-      for (int i=0; i<(int)arcs.size(); i++) {
-	if(arcs[i]->getIdRelation() == relationIds[position] &&
-	   arcs[i] != outArcWithRelation) {
-	  int newnodeid = arcs[i]->getTail()->getId();
-	  if (nodeIsNotInPath(path,newnodeid)) {
-	    path.push_back(newnodeid);
-	    leftEntitiesUsingDFS(outArcWithRelation, rule, origIds, path);
-	    path.pop_back();
-	  }
-	}
-      }
-    }
-  }
-  else {
-    if(relnodehasarc_[relationIds[position]][path.back()]) {
-      vector<Arc*>& arcs = outarcs_[path.back()];
-      for (int i=0; i<(int)arcs.size(); i++) {
-	if(arcs[i]->getIdRelation() == relationIds[position] &&
-	   arcs[i] != outArcWithRelation) {
-	  int newnodeid = arcs[i]->getHead()->getId();
-	  if (nodeIsNotInPath(path,newnodeid)) {
-	    path.push_back(newnodeid);
-	    leftEntitiesUsingDFS(outArcWithRelation, rule, origIds, path);
-	    path.pop_back();
-	  }
-	}
-      }
-    }
-  }
-
-  return;
+  walkRuleUsingDFS(rule, destId, true, ExcludedArc(outArcWithRelation), -1, &origIds);
 }
 
 void Data::getLeftEntities(Arc* outArcWithRelation, Rule& rule, 
 			   int destId, set<int>& origIds,
 			   bool useBFS)
 {
-  assert(rule.getLengthRule() >= 1);
-  if(useBFS)
-    leftEntitiesUsingBFS(outArcWithRelation, rule, destId, origIds);
-  else {
-    vector<int> path;
-    path.push_back(destId);
-    leftEntitiesUsingDFS(outArcWithRelation, rule, origIds, path);
-  }
+  vector<int> ids;
+  getLeftEntities(outArcWithRelation, rule, destId, ids, useBFS);
+  origIds.insert(ids.begin(), ids.end());
+}
+
+// The origins sorted and without repetitions
+void Data::getLeftEntities(Arc* outArcWithRelation, Rule& rule, 
+			   int destId, vector<int>& origIds,
+			   bool useBFS)
+{
+  getEntitiesExcluding(rule, destId, true, ExcludedArc(outArcWithRelation), origIds, useBFS);
 }
 
 void Data::createQueryFromTrainingData(Parameters& params)
@@ -1114,6 +1303,7 @@ void Data::createQueryFromTrainingData(Parameters& params)
 
 void Data::createQueryFromTrainingData(int relationId)
 {
+  ScopedTimer timer(Profile::QUERY_SETUP);
   queries_[relationId].resetQuery();
 
   int nrelations = (int)relations_.size();
@@ -1150,3 +1340,99 @@ void Data::createQueryFromTrainingData(int relationId)
     cout<<entities_[pairs[i].first]<<" "<<entities_[pairs[i].second]<<endl;
 #endif
 }
+
+void separateRelationsAndEntities(string input, vector<string>& output)
+{
+  istringstream ss( input );
+  string s;
+  getline( ss, s, '(' );
+  output.push_back(s);
+  getline( ss, s, ',' );
+  output.push_back(s);
+  getline( ss, s, ')' );
+  output.push_back(s);
+
+#if 0
+  for(int i=0; i<(int)output.size(); i++) {
+    cout<<output[i]<<" ";
+  }
+  cout<<endl;
+#endif
+}
+
+void separateStrings(string input, vector<vector<string> >& output)
+{
+  string s;
+  string stemp1, stemp2, stemp3;
+  istringstream ss( input );
+  int counter=1;
+  vector<string> values;
+  while (ss) {
+    string s;
+    if (!getline( ss, s, ' ' )) break;
+    if(s.compare("<=")==0) continue;
+    if(s.back() == ',') s.pop_back();
+    values.push_back(s);
+    counter++;
+  }
+#if 0
+  for(int i=0; i<(int)values.size(); i++)
+    cout<<values[i]<<" ";
+  cout<<endl;
+#endif
+  for(int i=0; i<(int)values.size(); i++) {
+    vector<string> relents;
+    separateRelationsAndEntities(values[i], relents);
+    assert(relents.size() > 0);
+    output.push_back(relents);
+  }
+}
+
+// Parses a line of a rules file as written by Solver::writeRulesToFile,
+// e.g. "0.5<tab>r(A,C) <= s(A,B), t(C,B)". The head is r(A,X) for the
+// rules of relation r and r(X,A) for the rules of its reverse, and the
+// body is a path of variables starting at A. Returns false if the line
+// does not contain a rule or uses an unknown relation.
+bool Data::parseRuleLine(string line, double& weight, int& relationId,
+			 bool& isReverseHead, Rule& rule)
+{
+  istringstream ss( line );
+  vector<string> values;
+  while (ss) {
+    string s;
+    if (!getline( ss, s, '\t' )) break;
+    values.push_back(s);
+  }
+  if(values.size() < 2)
+    return false;
+  weight = atof(values[0].c_str());
+  vector<vector<string> > output;
+  separateStrings(values[1], output);
+  if(output.size()<=1) return false; // some lines don't have rules
+  for(int i=0; i<(int)output.size(); i++)
+    if(output[i].size() != 3) return false;
+
+  map<string,int>::iterator it = maprelations_.find(output[0][0]);
+  if (it == maprelations_.end())
+    return false;
+  relationId = it->second;
+  isReverseHead = (output[0][1] != "A");
+
+  string currentVar = "A";
+  for(int i=1; i<(int)output.size(); i++) {
+    it = maprelations_.find(output[i][0]);
+    if (it == maprelations_.end())
+      return false;
+    if(output[i][1] == currentVar) {
+      rule.addRelationId(it->second, false);
+      currentVar = output[i][2];
+    }
+    else if(output[i][2] == currentVar) {
+      rule.addRelationId(it->second, true);
+      currentVar = output[i][1];
+    }
+    else
+      return false;
+  }
+  return true;
+}
@@ -6,6 +6,7 @@
 #define __DATA_HPP__
 
 #include "Parameters.hpp"
+#include "Profile.hpp"
 
 #include <fstream>
 #include <iostream>
@@ -22,6 +23,7 @@
 #include <cstring>
 #include <set>
 #include <limits.h>
+#include <stdint.h>
 
 using namespace std;
 
@@ -47,6 +49,34 @@ public:
   bool operator<(Rule& r);
 };
 
+// Prefix tree of the atoms of a set of rules, in the order in which
+// they are walked from the head of the rule (right side) or from its
+// tail (left side), so that the rules with a common prefix share its
+// walk. The rules are numbered in the order in which they are added.
+class RuleTrie {
+public:
+  struct Edge {
+    int relationId;
+    bool useInArcs; // walk the arc backwards, from its head to its tail
+    int child;
+  };
+
+private:
+  bool isLeft_;
+  int numRules_;
+  vector<vector<Edge> > edges_; // by node, the root is node 0
+  vector<vector<int> > rules_; // rules that end at each node
+
+public:
+  RuleTrie(bool isLeft):isLeft_(isLeft),numRules_(0),edges_(1),rules_(1) {}
+  ~RuleTrie() {}
+
+  void addRule(Rule& rule);
+  int getNumRules() {return numRules_;}
+  vector<Edge>& getEdges(int node) {return edges_[node];}
+  vector<int>& getRules(int node) {return rules_[node];}
+};
+
 class TestData {
 private:
   vector<pair<int,int> > entpairs_;
@@ -98,6 +128,24 @@ public:
   int getIdRelation() {return idrelation_;}
 };
 
+// Exclusion policies of the rule walks: the arcs that the paths may not
+// use. The walks are templates on the policy, so that the test compiles
+// away when no arc is excluded.
+class NoExcludedArcs {
+public:
+  bool isExcluded(Arc*) const {return false;}
+};
+
+// the training arc of the pair being explained
+class ExcludedArc {
+private:
+  Arc* arc_;
+
+public:
+  ExcludedArc(Arc* arc):arc_(arc) {}
+  bool isExcluded(Arc* arc) const {return arc == arc_;}
+};
+
 class Query {
 private:
   vector<pair<int,int> > entpairs_;
@@ -125,20 +173,30 @@ private:
   vector<vector<Arc*> > outarcs_;
   vector<vector<Arc*> > inarcs_;
   vector<string> entities_;
+  map<string,int> mapentities_;
   vector<string> relations_;
   map<string,int> maprelations_;
   vector<vector<bool> > relnodehasarc_;
   vector<vector<bool> > relnodehasinvarc_;
+  vector<vector<uint64_t> > relnodehasarcbits_; // relnodehasarc_ in 64 bit words, for the bottom-up steps of entitiesUsingFrontiers
+  vector<vector<uint64_t> > relnodehasinvarcbits_;
+  // statistics of the relations for the planner of the rule walks. The
+  // sides of relation r are 2*r, the entities with an out arc of r, and
+  // 2*r+1, those with an in arc.
+  vector<int> relnumarcs_;
+  vector<int> relsidesizes_;
+  vector<int> relsideoverlaps_; // entities in both sides, by pair of sides
   Query query_;
   vector<Query> queries_;
   TestData testdata_;
   TestData validdata_;
   int maxcomplexity_;
   bool repeatedNodesAllowed_;
+  bool planRuleWalks_;
 
 public:
   Data(int maxcomplexity)
-    :maxcomplexity_(maxcomplexity) {}
+    :maxcomplexity_(maxcomplexity),planRuleWalks_(false) {}
   ~Data();
 
   void cleanup();
@@ -154,6 +212,7 @@ public:
   vector<vector<Arc*> >& getOutArcs() {return outarcs_;}
   vector<vector<Arc*> >& getInArcs() {return inarcs_;}
   vector<string>& getEntities() {return entities_;}
+  map<string,int>& getMapEntities() {return mapentities_;}
   vector<string>& getRelations() {return relations_;}
   map<string,int>& getMapRelations() {return  maprelations_;}  
   int getNumberRelations() {return (int)relations_.size();}
@@ -164,19 +223,68 @@ public:
   int getNumPairsQuery() {return query_.getNumEntityPairs();}
   int getNumPairsQuery(int relationId) {return queries_[relationId].getNumEntityPairs();}
   int getMaxComplexity() {return maxcomplexity_;}
+  void setRepeatedNodesAllowed(bool allowed) {repeatedNodesAllowed_ = allowed;}
+  bool getRepeatedNodesAllowed() {return repeatedNodesAllowed_;}
+  void setPlanRuleWalks(bool plan) {planRuleWalks_ = plan;}
+  bool getPlanRuleWalks() {return planRuleWalks_;}
+
+  void computeRelationStatistics();
+  int getRelationNumArcs(int relationId) {return relnumarcs_[relationId];}
+  double getAvgOutDegree(int relationId); // over the entities with an out arc of the relation
+  double getAvgInDegree(int relationId);
+  double estimateWalk(Rule& rule, int entityId, bool isLeft,
+		      double& frontierNodes);
+  bool planUseBFS(Rule& rule, int entityId, bool isLeft, double& estimate);
+  bool planIsLeft(Rule& rule, pair<int,int>& pair, bool useFrontiers,
+		  double& estimate);
 
   void getNumPaths(int relationId, Rule& rule, vector<int>& numpaths);
+  void getPathCounts(int relationId, Rule& rule, int maxPaths,
+		     vector<int>& counts);
 
   bool hasPath(Rule& rule, pair<int,int>& pair);
+  int countPaths(Rule& rule, pair<int,int>& pair, int maxPaths);
   bool hasPath(Rule& rule, pair<int,int>& pair, 
 	       Arc* outArcWithRelation);
   bool nodeIsNotInPath(vector<int>& path, int nodeid);
   bool nodeIsNotInPath(vector<vector<pair<int,int> > >& q, int k, int l, int nodeid);
 
-  bool depthFirstSearch(Rule& rule, int destid, 
-			vector<int>& path);
-  bool depthFirstSearch(Rule& rule, int destid, 
-			vector<int>& path, 
+  template<class Exclusion>
+  int walkRuleUsingDFS(Rule& rule, int entityId, bool isLeft,
+		       const Exclusion& exclusion, int destId,
+		       vector<int>* entities, int maxPaths=1);
+  template<class Exclusion>
+  void walkRuleUsingBFS(Rule& rule, int entityId, bool isLeft,
+			const Exclusion& exclusion,
+			vector<int>& entities);
+  template<class Exclusion>
+  void entitiesUsingFrontiers(Rule& rule, int entityId, bool isLeft,
+			      const Exclusion& exclusion,
+			      vector<int>& entities);
+  template<class Exclusion>
+  void getEntitiesExcluding(Rule& rule, int entityId, bool isLeft,
+			    const Exclusion& exclusion,
+			    vector<int>& entities, bool useBFS);
+  template<class Exclusion>
+  bool hasPathExcluding(Rule& rule, pair<int,int>& pair,
+			const Exclusion& exclusion);
+  template<class Exclusion>
+  int countPathsUsingFrontiers(Rule& rule, int entityId, bool isLeft,
+			       const Exclusion& exclusion, int destId,
+			       int maxPaths, vector<int>* entities=NULL,
+			       vector<int>* counts=NULL);
+  template<class Exclusion>
+  int countPathsExcluding(Rule& rule, pair<int,int>& pair,
+			  const Exclusion& exclusion, int maxPaths);
+  template<class Exclusion>
+  void getEntityPathCountsExcluding(Rule& rule, int entityId, bool isLeft,
+				    const Exclusion& exclusion, int maxPaths,
+				    vector<int>& entities, vector<int>& counts);
+  void getEntityPathCounts(Rule& rule, int entityId, bool isLeft,
+			   int maxPaths, vector<int>& entities,
+			   vector<int>& counts);
+  bool depthFirstSearch(Rule& rule, int origid, int destid);
+  bool depthFirstSearch(Rule& rule, int origid, int destid,
 			Arc* outArcWithRelation);
   bool hasPathDfs(Rule& rule, pair<int,int>& pair);
   bool hasPathDfs(Rule& rule, pair<int,int>& pair,
@@ -184,48 +292,71 @@ public:
 
   void rightEntitiesUsingBFS(Rule& rule, 
 			     int origId,
-			     set<int>& destIds);
+			     vector<int>& destIds);
   void rightEntitiesUsingDFS(Rule& rule, 
-			     set<int>& destIds, 
-			     vector<int>& path);
+			     int origId,
+			     vector<int>& destIds);
   void getRightEntities(Rule& rule, int origId, 
 			set<int>& destIds, bool useBFS);
+  void getRightEntities(Rule& rule, int origId, 
+			vector<int>& destIds, bool useBFS);
   void leftEntitiesUsingBFS(Rule& rule, 
 			    int destId,
-			    set<int>& origIds);
+			    vector<int>& origIds);
   void leftEntitiesUsingDFS(Rule& rule, 
-			    set<int>& origIds, 
-			    vector<int>& path);
+			    int destId,
+			    vector<int>& origIds);
   void getLeftEntities(Rule& rule, int destId, 
 		       set<int>& origIds, bool useBFS);
+  void getLeftEntities(Rule& rule, int destId, 
+		       vector<int>& origIds, bool useBFS);
+  void getEntitiesOfRules(RuleTrie& trie, int entityId,
+			  vector<vector<int> >& entities,
+			  vector<int>& touchedRules);
+  void walkRuleTrie(RuleTrie& trie, int node, vector<int>& path,
+		    vector<vector<int> >& entities,
+		    vector<int>& touchedRules);
   void rightEntitiesUsingBFS(Arc* outArcWithRelation,
 			     Rule& rule, 
 			     int origId,
-			     set<int>& destIds);
+			     vector<int>& destIds);
   void rightEntitiesUsingDFS(Arc* outArcWithRelation,
 			     Rule& rule, 
-			     set<int>& destIds, 
-			     vector<int>& path);
+			     int origId,
+			     vector<int>& destIds);
   void getRightEntities(Arc* outArcWithRelation, Rule& rule, 
 			int origId, set<int>& destIds, 
 			bool useBFS);
+  void getRightEntities(Arc* outArcWithRelation, Rule& rule, 
+			int origId, vector<int>& destIds, 
+			bool useBFS);
   void leftEntitiesUsingBFS(Arc* outArcWithRelation,
 			    Rule& rule, 
 			    int destId,
-			    set<int>& origIds);
+			    vector<int>& origIds);
   void leftEntitiesUsingDFS(Arc* outArcWithRelation,
 			    Rule& rule, 
-			    set<int>& origIds, 
-			    vector<int>& path);
+			    int destId,
+			    vector<int>& origIds);
   void getLeftEntities(Arc* outArcWithRelation, Rule& rule, 
 		       int destId, set<int>& origIds,
 		       bool useBFS);
+  void getLeftEntities(Arc* outArcWithRelation, Rule& rule, 
+		       int destId, vector<int>& origIds,
+		       bool useBFS);
 
   TestData& getTestData() {return testdata_;}
   TestData& getValidData() {return validdata_;}
 
   void createQueryFromTrainingData(Parameters& params);
   void createQueryFromTrainingData(int relationId);
+
+  bool parseRuleLine(string line, double& weight, int& relationId,
+		     bool& isReverseHead, Rule& rule);
 };
 
+// helpers to read the rules files
+void separateRelationsAndEntities(string input, vector<string>& output);
+void separateStrings(string input, vector<vector<string> >& output);
+
 #endif
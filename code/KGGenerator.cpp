@@ -0,0 +1,254 @@
+// © Copyright IBM Corporation 2022. All Rights Reserved.
+// LICENSE: Eclipse Public License - v 2.0, https://opensource.org/licenses/EPL-2.0
+// SPDX-License-Identifier: EPL-2.0
+
+#include "KGGenerator.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <cassert>
+#include <sys/stat.h>
+
+using namespace std;
+
+KGGenerator::KGGenerator(uint64_t seed):
+  numEntities_(10000),
+  numRelations_(20),
+  numTriples_(100000),
+  degreeExponent_(2.5),
+  numRules_(5),
+  ruleLength_(2),
+  numInstances_(1000),
+  confidence_(0.9),
+  validFraction_(0.05),
+  testFraction_(0.05),
+  rng_(seed),
+  zipfExponent_(0.0),
+  zipfRange_(0.0)
+{
+}
+
+double KGGenerator::uniform(int purpose, uint64_t index, uint32_t draw)
+{
+  return rng_.uniform(CounterRNG::SYNTHETIC_GRAPH,
+		      ((uint32_t)purpose << 24) | draw,
+		      (uint32_t)index, (uint32_t)(index >> 32));
+}
+
+// Inverse of the distribution function of the continuous power law
+// on [0,numEntities_), rounded down and shifted by the offset of the
+// relation and side
+int KGGenerator::drawEntity(int relationId, int side, int purpose,
+			    uint64_t index, uint32_t draw)
+{
+  double u = uniform(purpose, index, draw);
+  double x;
+  if(zipfExponent_ == 0.0)
+    x = u * numEntities_;
+  else if(zipfExponent_ == 1.0)
+    x = pow(numEntities_+1.0, u) - 1.0;
+  else
+    x = pow(1.0 + u*zipfRange_, 1.0/(1.0-zipfExponent_)) - 1.0;
+  int rank = (int)x;
+  if(rank >= numEntities_)
+    rank = numEntities_-1;
+  int entity = rank + offsets_[2*relationId+side];
+  if(entity >= numEntities_)
+    entity -= numEntities_;
+  return entity;
+}
+
+void KGGenerator::generate()
+{
+  assert(numEntities_ > 1 && numRelations_ > 0);
+
+  // a power law of the degrees with exponent gamma is obtained from
+  // the ranks with exponent 1/(gamma-1)
+  zipfExponent_ = 0.0;
+  if(degreeExponent_ > 1.0)
+    zipfExponent_ = 1.0/(degreeExponent_-1.0);
+  if(zipfExponent_ != 0.0 && zipfExponent_ != 1.0)
+    zipfRange_ = pow(numEntities_+1.0, 1.0-zipfExponent_) - 1.0;
+
+  offsets_.resize(2*numRelations_);
+  for(int i=0; i<2*numRelations_; i++)
+    offsets_[i] = rng_.uniformInt(numEntities_, CounterRNG::SYNTHETIC_GRAPH, (uint32_t)OFFSET << 24, i, 0);
+
+  triples_.clear();
+  plantRules();
+  generateBackground();
+
+  sort(triples_.begin(), triples_.end());
+  triples_.erase(unique(triples_.begin(), triples_.end()), triples_.end());
+
+  split_.resize(triples_.size());
+  long numValid = 0, numTest = 0;
+  for(long i=0; i<(long)triples_.size(); i++) {
+    double u = uniform(SPLIT, i, 0);
+    if(triples_[i].trainOnly)
+      split_[i] = 0;
+    else if(u < validFraction_) {
+      split_[i] = 1;
+      numValid++;
+    }
+    else if(u < validFraction_ + testFraction_) {
+      split_[i] = 2;
+      numTest++;
+    }
+    else
+      split_[i] = 0;
+  }
+
+  cout<<"Triples: "<<triples_.size()<<", train: "<<triples_.size()-numValid-numTest<<", valid: "<<numValid<<", test: "<<numTest<<endl;
+}
+
+void KGGenerator::plantRules()
+{
+  rules_.clear();
+  if(numRelations_ < 2 || ruleLength_ < 1)
+    return;
+
+  int numRules = min(numRules_, numRelations_);
+  for(int k=0; k<numRules; k++) {
+    PlantedRule rule;
+    rule.headRelation = k;
+    for(int j=0; j<ruleLength_; j++) {
+      // any relation but the head
+      int relationId = rng_.uniformInt(numRelations_-1, CounterRNG::SYNTHETIC_GRAPH, ((uint32_t)RULE_CHOICE << 24) | 0, k, j);
+      if(relationId >= k)
+	relationId++;
+      rule.relationIds.push_back(relationId);
+      rule.isReverseArc.push_back(rng_.coinFlip(CounterRNG::SYNTHETIC_GRAPH, ((uint32_t)RULE_CHOICE << 24) | 1, k, j));
+    }
+    rules_.push_back(rule);
+  }
+
+  // each instance writes the ruleLength_ triples of the body and the
+  // head in its own slots, and the slots that are not used keep a
+  // tail of -1
+  long slotsPerInstance = ruleLength_ + 1;
+  long numInstances = (long)numRules * numInstances_;
+  vector<Triple> planted(numInstances * slotsPerInstance);
+#pragma omp parallel for schedule(static)
+  for(long index=0; index<numInstances; index++) {
+    PlantedRule& rule = rules_[index / numInstances_];
+    Triple* slots = &planted[index * slotsPerInstance];
+    for(int j=0; j<slotsPerInstance; j++)
+      slots[j].tail = -1;
+
+    vector<int> path(ruleLength_+1);
+    for(int j=0; j<ruleLength_; j++) {
+      int side = (rule.isReverseArc[j] ? 1 : 0);
+      if(j == 0)
+	path[0] = drawEntity(rule.relationIds[0], side, RULE_BODY, index, 0);
+      path[j+1] = drawEntity(rule.relationIds[j], 1-side, RULE_BODY, index, j+1);
+    }
+    // the rules are learned on paths without repeated nodes
+    bool repeated = false;
+    for(int j=0; j<=ruleLength_ && !repeated; j++)
+      for(int l=0; l<j && !repeated; l++)
+	repeated = (path[j] == path[l]);
+    if(repeated)
+      continue;
+
+    for(int j=0; j<ruleLength_; j++) {
+      Triple& t = slots[j];
+      t.relation = rule.relationIds[j];
+      t.trainOnly = true;
+      if(rule.isReverseArc[j]) {
+	t.tail = path[j+1];
+	t.head = path[j];
+      }
+      else {
+	t.tail = path[j];
+	t.head = path[j+1];
+      }
+    }
+    if(uniform(RULE_HEAD, index, 0) < confidence_) {
+      Triple& t = slots[ruleLength_];
+      t.tail = path[0];
+      t.relation = rule.headRelation;
+      t.head = path[ruleLength_];
+      t.trainOnly = false;
+    }
+  }
+
+  for(long i=0; i<(long)planted.size(); i++)
+    if(planted[i].tail >= 0)
+      triples_.push_back(planted[i]);
+}
+
+void KGGenerator::generateBackground()
+{
+  long first = (long)triples_.size();
+  triples_.resize(first + numTriples_);
+#pragma omp parallel for schedule(static)
+  for(long i=0; i<numTriples_; i++) {
+    Triple& t = triples_[first+i];
+    t.relation = rng_.uniformInt(numRelations_, CounterRNG::SYNTHETIC_GRAPH, (uint32_t)BACKGROUND << 24, (uint32_t)i, (uint32_t)(i >> 32));
+    t.tail = drawEntity(t.relation, 0, BACKGROUND, i, 1);
+    t.head = drawEntity(t.relation, 1, BACKGROUND, i, 2);
+    t.trainOnly = false;
+  }
+}
+
+// The files are written with '\n' instead of endl, which would flush
+// the stream on every one of the (possibly hundreds of millions) lines
+void KGGenerator::writeFiles(string dname)
+{
+  mkdir(dname.c_str(), 0755);
+
+  {
+    ofstream outfile((dname+"/entity2id.txt").c_str());
+    for(int i=0; i<numEntities_; i++)
+      outfile<<"e"<<i<<"\t"<<i<<"\n";
+  }
+  {
+    ofstream outfile((dname+"/relation2id.txt").c_str());
+    for(int i=0; i<numRelations_; i++)
+      outfile<<"r"<<i<<"\t"<<i<<"\n";
+  }
+
+  string fnames[3] = {"train.txt", "valid.txt", "test.txt"};
+  for(int k=0; k<3; k++) {
+    ofstream outfile((dname+"/"+fnames[k]).c_str());
+    for(long i=0; i<(long)triples_.size(); i++) {
+      if(split_[i] != k) continue;
+      Triple& t = triples_[i];
+      outfile<<"e"<<t.tail<<"\tr"<<t.relation<<"\te"<<t.head<<"\n";
+    }
+  }
+
+  writeRulesFile(dname+"/planted_rules.txt");
+  cout<<"Graph written to "<<dname<<endl;
+}
+
+// Writes the planted rules in the format of the rules file of LPRules,
+// with the confidence as the weight
+void KGGenerator::writeRulesFile(string fname)
+{
+  ofstream outfile(fname.c_str());
+  string alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+  for(int k=0; k<(int)rules_.size(); k++) {
+    PlantedRule& rule = rules_[k];
+    int len = (int)rule.relationIds.size();
+    assert(len < (int)alphabet.length());
+    outfile<<confidence_<<"\t";
+    outfile<<"r"<<rule.headRelation<<"(A,"<<alphabet[len]<<") <=";
+    for(int j=0; j<len; j++) {
+      if(j==0)
+	outfile<<" ";
+      else
+	outfile<<", ";
+      outfile<<"r"<<rule.relationIds[j];
+      if(rule.isReverseArc[j])
+	outfile<<"("<<alphabet[j+1]<<","<<alphabet[j]<<")";
+      else
+	outfile<<"("<<alphabet[j]<<","<<alphabet[j+1]<<")";
+    }
+    outfile<<endl;
+  }
+}
@@ -0,0 +1,106 @@
+// © Copyright IBM Corporation 2022. All Rights Reserved.
+// LICENSE: Eclipse Public License - v 2.0, https://opensource.org/licenses/EPL-2.0
+// SPDX-License-Identifier: EPL-2.0
+
+#ifndef __KGGENERATOR_HPP__
+#define __KGGENERATOR_HPP__
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "CounterRNG.hpp"
+
+using namespace std;
+
+// Generates a synthetic knowledge graph in the format of the datasets
+// (entity2id.txt, relation2id.txt, train.txt, valid.txt, test.txt) to
+// benchmark rule mining and scoring on graphs of any size.
+//
+// The graph is the union of random background triples and of planted
+// rules. The endpoints of the triples are drawn from a power law on the
+// entities, shifted differently for each relation and side, so that
+// every relation has its own hubs. Each planted rule has a head
+// relation and a body that is a path of ruleLength relations; an
+// instance of the rule adds the triples of a body path between entities
+// drawn from the same power law, and the head triple with probability
+// confidence. Duplicate triples are removed and the rest are split at
+// random into train, valid and test, except for the triples of the
+// bodies, which are all in train so that the held out head triples can
+// be predicted by the planted rules. Every draw is a function of the
+// seed and of the index of the draw, so the output does not depend on
+// the number of threads.
+class KGGenerator {
+public:
+  struct Triple {
+    int tail;
+    int relation;
+    int head;
+    bool trainOnly; // triples of the bodies of the planted rules are never held out
+    bool operator<(const Triple& t) const
+    {
+      if(tail != t.tail) return tail < t.tail;
+      if(relation != t.relation) return relation < t.relation;
+      if(head != t.head) return head < t.head;
+      return trainOnly && !t.trainOnly; // so that unique() keeps the copy that is trainOnly
+    }
+    bool operator==(const Triple& t) const
+    {return tail==t.tail && relation==t.relation && head==t.head;}
+  };
+  struct PlantedRule {
+    int headRelation;
+    vector<int> relationIds;
+    vector<bool> isReverseArc;
+  };
+
+private:
+  int numEntities_;
+  int numRelations_;
+  long numTriples_; // background triples
+  double degreeExponent_; // exponent of the power law of the degrees, <= 1 for uniform endpoints
+  int numRules_;
+  int ruleLength_;
+  long numInstances_; // instances of each planted rule
+  double confidence_; // probability that an instance of the body adds the head triple
+  double validFraction_;
+  double testFraction_;
+  CounterRNG rng_;
+  double zipfExponent_; // the k-th entity of a side is drawn with probability proportional to (k+1)^-zipfExponent_
+  double zipfRange_;
+  vector<int> offsets_; // first entity of the power law of each relation and side
+
+  vector<PlantedRule> rules_;
+  vector<Triple> triples_;
+  vector<int> split_; // 0 train, 1 valid, 2 test
+
+  enum Purpose {BACKGROUND, RULE_BODY, RULE_HEAD, RULE_CHOICE, OFFSET, SPLIT};
+
+  double uniform(int purpose, uint64_t index, uint32_t draw);
+  int drawEntity(int relationId, int side, int purpose, uint64_t index, uint32_t draw);
+  void plantRules();
+  void generateBackground();
+
+public:
+  KGGenerator(uint64_t seed=1234);
+  ~KGGenerator() {}
+
+  void setSeed(uint64_t seed) {rng_ = CounterRNG(seed);}
+  void setNumEntities(int n) {numEntities_ = n;}
+  void setNumRelations(int n) {numRelations_ = n;}
+  void setNumTriples(long n) {numTriples_ = n;}
+  void setDegreeExponent(double exponent) {degreeExponent_ = exponent;}
+  void setNumRules(int n) {numRules_ = n;}
+  void setRuleLength(int length) {ruleLength_ = length;}
+  void setNumInstances(long n) {numInstances_ = n;}
+  void setConfidence(double confidence) {confidence_ = confidence;}
+  void setValidFraction(double fraction) {validFraction_ = fraction;}
+  void setTestFraction(double fraction) {testFraction_ = fraction;}
+
+  void generate();
+  void writeFiles(string dname);
+  void writeRulesFile(string fname);
+  vector<Triple>& getTriples() {return triples_;}
+  vector<PlantedRule>& getRules() {return rules_;}
+};
+
+#endif
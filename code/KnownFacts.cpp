@@ -0,0 +1,145 @@
+// © Copyright IBM Corporation 2022. All Rights Reserved.
+// LICENSE: Eclipse Public License - v 2.0, https://opensource.org/licenses/EPL-2.0
+// SPDX-License-Identifier: EPL-2.0
+
+#include "KnownFacts.hpp"
+
+#include <algorithm>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+void KnownFacts::build(Data& data)
+{
+  numRelations_ = data.getNumberRelations();
+  indexes_.clear();
+  indexes_.resize(numRelations_*NUM_COMBINATIONS*2);
+
+  // pairs (tail,head) of each relation in each dataset
+  vector<vector<pair<int,int> > > trainPairs(numRelations_);
+  vector<Arc*>& arcs = data.getArcs();
+  for(int i=0; i<(int)arcs.size(); i++) {
+    Arc* arc = arcs[i];
+    trainPairs[arc->getIdRelation()].push_back(pair<int,int>(arc->getTail()->getId(), arc->getHead()->getId()));
+  }
+  TestData& validdata = data.getValidData();
+  TestData& testdata = data.getTestData();
+
+#pragma omp parallel for schedule(dynamic)
+  for(int relationId=0; relationId<numRelations_; relationId++) {
+    vector<pair<int,int> > pairs(trainPairs[relationId]);
+    for(int combination=0; combination<NUM_COMBINATIONS; combination++) {
+      if(combination == TRAIN_VALID) {
+	vector<pair<int,int> >& entpairs = validdata.getEntityPairs(relationId);
+	pairs.insert(pairs.end(), entpairs.begin(), entpairs.end());
+      }
+      else if(combination == TRAIN_VALID_TEST) {
+	vector<pair<int,int> >& entpairs = testdata.getEntityPairs(relationId);
+	pairs.insert(pairs.end(), entpairs.begin(), entpairs.end());
+      }
+      buildIndex(pairs, getIndex(relationId, combination, RIGHT));
+      vector<pair<int,int> > reversed(pairs.size());
+      for(int i=0; i<(int)pairs.size(); i++)
+	reversed[i] = pair<int,int>(pairs[i].second, pairs[i].first);
+      buildIndex(reversed, getIndex(relationId, combination, LEFT));
+    }
+  }
+}
+
+// Sorts the pairs, which are left sorted and without repetitions
+void KnownFacts::buildIndex(vector<pair<int,int> >& pairs, Index& index)
+{
+  sort(pairs.begin(), pairs.end());
+  pairs.erase(unique(pairs.begin(), pairs.end()), pairs.end());
+
+  index.keys.clear();
+  index.offsets.clear();
+  index.values.resize(pairs.size());
+  for(int i=0; i<(int)pairs.size(); i++) {
+    if(i == 0 || pairs[i].first != pairs[i-1].first) {
+      index.keys.push_back(pairs[i].first);
+      index.offsets.push_back(i);
+    }
+    index.values[i] = pairs[i].second;
+  }
+  index.offsets.push_back((int)pairs.size());
+}
+
+void KnownFacts::getEntitiesOfKey(int relationId, int combination, int side,
+				  int k, const int*& first, const int*& last)
+{
+  Index& index = getIndex(relationId, combination, side);
+  first = index.values.data() + index.offsets[k];
+  last = index.values.data() + index.offsets[k+1];
+}
+
+void KnownFacts::getEntities(int relationId, int combination, int side,
+			     int entityId, const int*& first, const int*& last)
+{
+  Index& index = getIndex(relationId, combination, side);
+  vector<int>::iterator it = lower_bound(index.keys.begin(), index.keys.end(), entityId);
+  if(it == index.keys.end() || *it != entityId) {
+    first = last = index.values.data();
+    return;
+  }
+  int k = (int)(it - index.keys.begin());
+  first = index.values.data() + index.offsets[k];
+  last = index.values.data() + index.offsets[k+1];
+}
+
+bool KnownFacts::contains(int relationId, int combination, int side,
+			  int entityId, int otherId)
+{
+  const int* first;
+  const int* last;
+  getEntities(relationId, combination, side, entityId, first, last);
+  return binary_search(first, last, otherId);
+}
+
+// Counts the entities that are also known and subtracts them. With SSE2
+// the arrays are merged in blocks of four: each block of first is
+// compared with the four rotations of the block of known, and the block
+// with the smaller last entity is advanced (both if they are equal).
+// The rest is merged one entity at a time.
+int KnownFacts::countNotKnown(const int* first, const int* last,
+			      const int* known, const int* knownEnd)
+{
+  int numEntities = (int)(last - first);
+  int numCommon = 0;
+#ifdef __SSE2__
+  const int* lastBlock = first + ((last - first) & ~3);
+  const int* knownLastBlock = known + ((knownEnd - known) & ~3);
+  while(first < lastBlock && known < knownLastBlock) {
+    __m128i a = _mm_loadu_si128((const __m128i*)first);
+    __m128i b = _mm_loadu_si128((const __m128i*)known);
+    __m128i eq = _mm_cmpeq_epi32(a, b);
+    b = _mm_shuffle_epi32(b, _MM_SHUFFLE(0,3,2,1));
+    eq = _mm_or_si128(eq, _mm_cmpeq_epi32(a, b));
+    b = _mm_shuffle_epi32(b, _MM_SHUFFLE(0,3,2,1));
+    eq = _mm_or_si128(eq, _mm_cmpeq_epi32(a, b));
+    b = _mm_shuffle_epi32(b, _MM_SHUFFLE(0,3,2,1));
+    eq = _mm_or_si128(eq, _mm_cmpeq_epi32(a, b));
+    numCommon += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(eq)));
+    int lastA = first[3];
+    int lastB = known[3];
+    if(lastA <= lastB)
+      first += 4;
+    if(lastB <= lastA)
+      known += 4;
+  }
+#endif
+  while(first != last && known != knownEnd) {
+    if(*first < *known)
+      first++;
+    else if(*known < *first)
+      known++;
+    else {
+      numCommon++;
+      first++;
+      known++;
+    }
+  }
+  return numEntities - numCommon;
+}
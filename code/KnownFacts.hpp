@@ -0,0 +1,69 @@
+// © Copyright IBM Corporation 2022. All Rights Reserved.
+// LICENSE: Eclipse Public License - v 2.0, https://opensource.org/licenses/EPL-2.0
+// SPDX-License-Identifier: EPL-2.0
+
+#ifndef __KNOWNFACTS_HPP__
+#define __KNOWNFACTS_HPP__
+
+#include <vector>
+
+#include "Data.hpp"
+
+using namespace std;
+
+// Known pairs of each relation, indexed by entity, for the three
+// combinations of the data used by the rankings: train, train + valid,
+// and train + valid + test. The right side gives the heads of a tail,
+// the left side the tails of a head. Each index is a sorted array of
+// the entities that have pairs (the keys), the offsets of their pairs,
+// and the other entities of the pairs, sorted and without repetitions,
+// so it is built once after reading the data instead of scanning the
+// arcs each time the pairs of a relation are needed.
+class KnownFacts {
+public:
+  enum Combination {TRAIN, TRAIN_VALID, TRAIN_VALID_TEST, NUM_COMBINATIONS};
+  static const int RIGHT = 0;
+  static const int LEFT = 1;
+
+private:
+  struct Index {
+    vector<int> keys;
+    vector<int> offsets; // keys.size()+1 offsets into values
+    vector<int> values;
+  };
+
+  int numRelations_;
+  vector<Index> indexes_; // by relation, combination and side
+
+  Index& getIndex(int relationId, int combination, int side)
+  {return indexes_[(relationId*NUM_COMBINATIONS + combination)*2 + side];}
+  static void buildIndex(vector<pair<int,int> >& pairs, Index& index);
+
+public:
+  KnownFacts():numRelations_(0) {}
+  ~KnownFacts() {}
+
+  void build(Data& data);
+  bool isBuilt() {return numRelations_ > 0;}
+
+  // entities that have pairs, in increasing order
+  int getNumKeys(int relationId, int combination, int side)
+  {return (int)getIndex(relationId, combination, side).keys.size();}
+  int getKey(int relationId, int combination, int side, int k)
+  {return getIndex(relationId, combination, side).keys[k];}
+  // the other entities of the pairs of the k-th key, in [first,last)
+  void getEntitiesOfKey(int relationId, int combination, int side, int k,
+			const int*& first, const int*& last);
+  // the other entities of the pairs of entityId, empty if it has none
+  void getEntities(int relationId, int combination, int side, int entityId,
+		   const int*& first, const int*& last);
+  bool contains(int relationId, int combination, int side, int entityId,
+		int otherId);
+
+  // Number of entities of the sorted array [first,last) that are not in
+  // the sorted array [known,knownEnd), both without repetitions
+  static int countNotKnown(const int* first, const int* last,
+			   const int* known, const int* knownEnd);
+};
+
+#endif
@@ -6,6 +6,7 @@
 
 //#include <iostream>
 #include <iomanip>
+#include <chrono>
 
 using namespace std;
 
@@ -16,6 +17,9 @@ Model2MasterLP::Model2MasterLP(int relationId, Data& d)
   numNonZerosPerRow_.resize(n_);
   minPercentCoverage_ = 0.0;
   penaltyOnPairsExtraCoverage_ = 0.0;
+  threadBudget_ = NULL;
+  largeLPMinColumns_ = 0;
+  largeLPAlgorithm_ = 0;
   model_ = IloModel(env_);
   createModelStructure();
   setInitParams();
@@ -179,7 +183,9 @@ bool Model2MasterLP::addColToLP(Rule& rule, vector<int>& column, double objPenal
 bool Model2MasterLP::addColToLP(Rule& rule, vector<double>& column, double objPenalty)
 {
   //  IloNumColumn colx = obj_(0); // this is for the model without penalty
-  IloNumColumn colx = obj_(objPenalty*(1+rule.getLengthRule()));
+  double objx = objPenalty*(1+rule.getLengthRule());
+  xObjValues_.push_back(objx);
+  IloNumColumn colx = obj_(objx);
   IloNumColumn colw = obj_(0);
 
   for (int i=0; i<n_; i++) {
@@ -225,10 +231,28 @@ bool Model2MasterLP::addColToLP(Rule& rule, vector<double>& column, double objPe
 
 void Model2MasterLP::solveModel(bool writeLpFile)
 {
+  ScopedTimer timer(Profile::LP_SOLVE);
+  ScopedTrace trace("solveModel", relationId_);
+  // small LPs are solved with one thread, large LPs take the
+  // threads that are not being used by other relations
+  int numberThreads = 1;
+  int extraThreads = 0;
+  int lpAlgorithm = 0; // 0 (automatic)
+  if(threadBudget_ != NULL && x_.getSize() >= largeLPMinColumns_) {
+    extraThreads = threadBudget_->acquire(threadBudget_->getTotal()-1);
+    numberThreads += extraThreads;
+    if(numberThreads > 1)
+      lpAlgorithm = largeLPAlgorithm_;
+  }
+
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
   try {
     if(writeLpFile)
       cpx_.exportModel("model.lp");
 
+    cpx_.setParam(IloCplex::Param::Threads, numberThreads);
+    cpx_.setParam(IloCplex::Param::RootAlgorithm, lpAlgorithm);
+
     // Optimize the problem and obtain solution.
     if ( !cpx_.solve() ) {
       env_.error() << "Failed to optimize LP" << endl;
@@ -260,7 +284,12 @@ void Model2MasterLP::solveModel(bool writeLpFile)
   catch (...) {
     cerr << "Unknown exception caught" << endl;
   }
-  
+
+  if(extraThreads > 0)
+    threadBudget_->release(extraThreads);
+
+  chrono::duration<double> wallTime = chrono::steady_clock::now() - start;
+  cout << "LP solve: wall time " << wallTime.count() << " secs, threads " << numberThreads << ", algorithm " << lpAlgorithm << ", columns " << x_.getSize() << endl;
 }
 
 void Model2MasterLP::setInitParams()
@@ -286,6 +315,15 @@ void Model2MasterLP::setInitParams()
   
 }
 
+void Model2MasterLP::setThreadBudget(ThreadBudget* threadBudget,
+				     int largeLPMinColumns,
+				     int largeLPAlgorithm)
+{
+  threadBudget_ = threadBudget;
+  largeLPMinColumns_ = largeLPMinColumns;
+  largeLPAlgorithm_ = largeLPAlgorithm;
+}
+
 void Model2MasterLP::getSolution(vector<double>& x, vector<double>& w)
 {
   try {
@@ -332,6 +370,59 @@ double Model2MasterLP::getDuals(vector<double>& duals_con11)
 
 }
 
+// Returns the dual of the complexity constraint con7, its slack, and
+// the range of its right hand side over which the current basis
+// remains optimal
+double Model2MasterLP::getComplexitySensitivity(double& rhsLower,
+						double& rhsUpper,
+						double& slack)
+{
+  double dual_con7 = 0.0;
+  rhsLower = -IloInfinity;
+  rhsUpper = IloInfinity;
+  slack = 0.0;
+
+  try {
+    dual_con7 = cpx_.getDual(con7_);
+    slack = cpx_.getSlack(con7_);
+
+    IloRangeArray cons(env_);
+    cons.add(con7_);
+    IloNumArray lower(env_), upper(env_);
+    cpx_.getRHSSA(lower, upper, cons);
+    rhsLower = lower[0];
+    rhsUpper = upper[0];
+    lower.end();
+    upper.end();
+    cons.end();
+  }
+  catch (IloException& e) {
+    cerr << "Concert exception caught: " << e << endl;
+  }
+  catch (...) {
+    cerr << "Unknown exception caught" << endl;
+  }
+
+  return dual_con7;
+}
+
+double Model2MasterLP::getObjValue()
+{
+  double objValue = 0.0;
+
+  try {
+    objValue = cpx_.getObjValue();
+  }
+  catch (IloException& e) {
+    cerr << "Concert exception caught: " << e << endl;
+  }
+  catch (...) {
+    cerr << "Unknown exception caught" << endl;
+  }
+
+  return objValue;
+}
+
 double Model2MasterLP::getReducedCost(Rule& rule, vector<int>& column, vector<double>& duals_con11)
 {
   if(column.size()==0) {
@@ -345,6 +436,15 @@ double Model2MasterLP::getReducedCost(Rule& rule, vector<int>& column, vector<do
   return rc;
 }
 
+// the same for a column of path counts (path_count_column)
+double Model2MasterLP::getReducedCost(vector<double>& column, vector<double>& duals_con11)
+{
+  double rc = 0.0;
+  for (int i=0; i<n_; i++)
+    rc -= duals_con11[i] * column[i];
+  return rc;
+}
+
 void Model2MasterLP::printLPStatistics()
 {
   int npairscovered = 0;
@@ -18,6 +18,8 @@
 #include <cstring>
 
 #include "Data.hpp"
+#include "ThreadBudget.hpp"
+#include "Trace.hpp"
 #include <ilcplex/ilocplex.h>
 
 using namespace std;
@@ -35,6 +37,9 @@ private:
   vector<int> numPairsExtraCoverage_; // number of entity pairs that are covered by columns but should not be
   double penaltyOnPairsExtraCoverage_;
   vector<double> xObjValues_;
+  ThreadBudget* threadBudget_; // if not NULL, large LPs take extra threads from it
+  int largeLPMinColumns_;
+  int largeLPAlgorithm_;
 
   IloEnv env_;
   IloModel model_;
@@ -60,10 +65,16 @@ public:
   bool addColToLP(Rule& rule, vector<double>& column, double objPenalty);
   void solveModel(bool writeLpFile);
   void setInitParams();
+  void setThreadBudget(ThreadBudget* threadBudget, int largeLPMinColumns,
+		       int largeLPAlgorithm);
   void getSolution(vector<double>& x, vector<double>& w);
   double getDuals(vector<double>& duals_con11);
+  double getObjValue();
+  double getComplexitySensitivity(double& rhsLower, double& rhsUpper,
+				  double& slack);
   double getReducedCost(Rule& rule, vector<int>& column, 
 			vector<double>& duals_con11);
+  double getReducedCost(vector<double>& column, vector<double>& duals_con11);
   void printLPStatistics();
   void setMinPercentCoverage(double minCov);
   bool isThereEnoughCoverage(int rowsCovered);
@@ -23,6 +23,23 @@ void Parameters::initialize()
   runMode_ = 0;
   maxItersColumnGeneration_ = 15;
   speedUpComputationNegK_ = false;
+  negKEstimator_ = false;
+  negKRelativeError_ = 0.05;
+  negKMinSample_ = 32;
+  batchExtraCoverage_ = false;
+  pathCountColumn_ = false;
+  pathCountMax_ = 1000;
+  planRuleWalks_ = false;
+  findBestComplexityParametric_ = false;
+  numberThreads_ = 1;
+  numberParallelRelations_ = 1;
+  largeLPMinColumns_ = 2000;
+  largeLPAlgorithm_ = 6; // concurrent
+  dualSmoothingAlpha_ = 0.0;
+  columnGenerationGapTolerance_ = 0.0;
+  ruleCacheSizeMB_ = 256;
+  writeProfile_ = false;
+  writeTrace_ = false;
 }
 
 void Parameters::readParamsFile(string fname)
@@ -146,6 +163,12 @@ void Parameters::readParamsFile(string fname)
     }
     else if(stemp1 == "find_best_complexity_ranking_type")
       findBestComplexityRankingType_ =  atoi(stemp2.c_str());
+    else if(stemp1 == "find_best_complexity_parametric") {
+      if(stemp2 == "true")
+	findBestComplexityParametric_ = true;
+      else
+	findBestComplexityParametric_ = false;
+    }
     else if(stemp1 == "alpha_convex_combination_model3")
       alphaConvexCombinationModel3_ =  atof(stemp2.c_str());
     else if(stemp1 == "penalty_on_negative_pairs") {
@@ -179,6 +202,62 @@ void Parameters::readParamsFile(string fname)
       else
 	speedUpComputationNegK_ = false;
     }
+    else if(stemp1 == "neg_k_estimator") {
+      if(stemp2 == "true")
+	negKEstimator_ = true;
+      else
+	negKEstimator_ = false;
+    }
+    else if(stemp1 == "neg_k_relative_error")
+      negKRelativeError_ =  atof(stemp2.c_str());
+    else if(stemp1 == "neg_k_min_sample")
+      negKMinSample_ =  atoi(stemp2.c_str());
+    else if(stemp1 == "batch_extra_coverage") {
+      if(stemp2 == "true")
+	batchExtraCoverage_ = true;
+      else
+	batchExtraCoverage_ = false;
+    }
+    else if(stemp1 == "path_count_column") {
+      if(stemp2 == "true")
+	pathCountColumn_ = true;
+      else
+	pathCountColumn_ = false;
+    }
+    else if(stemp1 == "path_count_max")
+      pathCountMax_ =  atoi(stemp2.c_str());
+    else if(stemp1 == "plan_rule_walks") {
+      if(stemp2 == "true")
+	planRuleWalks_ = true;
+      else
+	planRuleWalks_ = false;
+    }
+    else if(stemp1 == "number_threads")
+      numberThreads_ =  atoi(stemp2.c_str());
+    else if(stemp1 == "number_parallel_relations")
+      numberParallelRelations_ =  atoi(stemp2.c_str());
+    else if(stemp1 == "large_lp_min_columns")
+      largeLPMinColumns_ =  atoi(stemp2.c_str());
+    else if(stemp1 == "large_lp_algorithm")
+      largeLPAlgorithm_ =  atoi(stemp2.c_str());
+    else if(stemp1 == "dual_smoothing_alpha")
+      dualSmoothingAlpha_ =  atof(stemp2.c_str());
+    else if(stemp1 == "column_generation_gap_tolerance")
+      columnGenerationGapTolerance_ =  atof(stemp2.c_str());
+    else if(stemp1 == "rule_cache_size_mb")
+      ruleCacheSizeMB_ =  atoi(stemp2.c_str());
+    else if(stemp1 == "write_profile") {
+      if(stemp2 == "true")
+	writeProfile_ = true;
+      else
+	writeProfile_ = false;
+    }
+    else if(stemp1 == "write_trace") {
+      if(stemp2 == "true")
+	writeTrace_ = true;
+      else
+	writeTrace_ = false;
+    }
 
   }
 
@@ -187,6 +266,26 @@ void Parameters::readParamsFile(string fname)
 
   if(relationId_ >= 0)
     runOnlyWithRelationId_ = true;
+
+  if(numberThreads_ < 1)
+    numberThreads_ = 1;
+  if(numberParallelRelations_ < 1)
+    numberParallelRelations_ = 1;
+  if(numberParallelRelations_ > numberThreads_)
+    numberParallelRelations_ = numberThreads_;
+
+  if(dualSmoothingAlpha_ < 0.0 || dualSmoothingAlpha_ >= 1.0)
+    dualSmoothingAlpha_ = 0.0;
+
+  if(ruleCacheSizeMB_ < 0)
+    ruleCacheSizeMB_ = 0;
+
+  if(negKRelativeError_ < 0.0)
+    negKRelativeError_ = 0.0;
+  if(negKMinSample_ < 2)
+    negKMinSample_ = 2;
+  if(pathCountMax_ < 1)
+    pathCountMax_ = 1;
 }
 
 void Parameters::printParams()
@@ -254,6 +353,10 @@ void Parameters::printParams()
   else
     cout<<"run_find_best_complexity false"<<endl;
   cout<<"find_best_complexity_ranking_type "<<findBestComplexityRankingType_<<endl;
+  if(findBestComplexityParametric_)
+    cout<<"find_best_complexity_parametric true"<<endl;
+  else
+    cout<<"find_best_complexity_parametric false"<<endl;
   cout<<"alpha_convex_combination_model3 "<<alphaConvexCombinationModel3_<<endl;
   //  cout<<"penalty_on_negative_pairs "<<penaltyOnNegativePairs_<<endl;
   cout<<"penalty_on_negative_pairs";
@@ -274,5 +377,39 @@ void Parameters::printParams()
     cout<<"speed_up_computation_neg_k true"<<endl;
   else
     cout<<"speed_up_computation_neg_k false"<<endl;
+  if(negKEstimator_)
+    cout<<"neg_k_estimator true"<<endl;
+  else
+    cout<<"neg_k_estimator false"<<endl;
+  cout<<"neg_k_relative_error "<<negKRelativeError_<<endl;
+  cout<<"neg_k_min_sample "<<negKMinSample_<<endl;
+  if(batchExtraCoverage_)
+    cout<<"batch_extra_coverage true"<<endl;
+  else
+    cout<<"batch_extra_coverage false"<<endl;
+  if(pathCountColumn_)
+    cout<<"path_count_column true"<<endl;
+  else
+    cout<<"path_count_column false"<<endl;
+  cout<<"path_count_max "<<pathCountMax_<<endl;
+  if(planRuleWalks_)
+    cout<<"plan_rule_walks true"<<endl;
+  else
+    cout<<"plan_rule_walks false"<<endl;
+  cout<<"number_threads "<<numberThreads_<<endl;
+  cout<<"number_parallel_relations "<<numberParallelRelations_<<endl;
+  cout<<"large_lp_min_columns "<<largeLPMinColumns_<<endl;
+  cout<<"large_lp_algorithm "<<largeLPAlgorithm_<<endl;
+  cout<<"dual_smoothing_alpha "<<dualSmoothingAlpha_<<endl;
+  cout<<"column_generation_gap_tolerance "<<columnGenerationGapTolerance_<<endl;
+  cout<<"rule_cache_size_mb "<<ruleCacheSizeMB_<<endl;
+  if(writeProfile_)
+    cout<<"write_profile true"<<endl;
+  else
+    cout<<"write_profile false"<<endl;
+  if(writeTrace_)
+    cout<<"write_trace true"<<endl;
+  else
+    cout<<"write_trace false"<<endl;
   cout<<"-------------------------"<<endl;  
 }
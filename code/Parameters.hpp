@@ -45,6 +45,7 @@ private:
   int generateRules_; // 0 is enumeration, 1 is S0, 2 is heuristic
   bool runFindBestComplexity_;
   int findBestComplexityRankingType_; // 0 is aggresive, 1 is intermediate, 2 is conservative, 3 is randomBreak
+  bool findBestComplexityParametric_; // use the sensitivity of the complexity constraint to skip repeated evaluations
   double alphaConvexCombinationModel3_;
   //  double penaltyOnNegativePairs_;
   vector<double> penaltyOnNegativePairs_;
@@ -54,6 +55,22 @@ private:
   int runMode_; // 0 is normal, 1 is read rules + score, 2 is read rules + run LP + score, 3 is read rules + add new rules + run LP + score
   int maxItersColumnGeneration_;
   bool speedUpComputationNegK_;
+  bool negKEstimator_; // estimate the pairs of extra coverage of a rule from a uniform sample of the entities of the relation
+  double negKRelativeError_; // the sample grows until the 95% confidence interval of the estimate is within this relative error
+  int negKMinSample_; // entities sampled on each side before the error is first checked
+  bool batchExtraCoverage_; // compute the pairs of extra coverage of all the candidate rules in one walk of their prefix tree from each entity
+  bool pathCountColumn_; // model 2 columns weighted by the number of paths of the rule for each pair instead of 0/1, and the scores of the valid and test pairs too
+  int pathCountMax_; // the paths are counted up to this number
+  bool planRuleWalks_; // choose per rule and entity the direction and the search (BFS or DFS) with the smallest estimated cost, instead of use_breadth_first_search
+  int numberThreads_; // total number of threads (relations, pricing of candidate rules and CPLEX)
+  int numberParallelRelations_; // number of relations solved concurrently
+  int largeLPMinColumns_; // LPs with at least this many columns may use more than one CPLEX thread
+  int largeLPAlgorithm_; // CPLEX root algorithm for large LPs solved with more than one thread
+  double dualSmoothingAlpha_; // 0 prices with the LP duals, 0<alpha<1 smooths them towards a stability center
+  double columnGenerationGapTolerance_; // stop column generation once the relative gap to the Lagrangian bound is below this (0 disables the test)
+  int ruleCacheSizeMB_; // memory for the cache of entities reached by the selected rules, 0 disables it
+  bool writeProfile_; // write the time of each phase and the search counters of every relation to <scores>.profile.json
+  bool writeTrace_; // write a timeline of the relations, LP solves and rule generators of every thread to <scores>.trace.json
 
   bool runOnlyWithRelationId_;
 
@@ -134,6 +151,9 @@ public:
   void addFindBestComplexityRankingType(int rankingType) {findBestComplexityRankingType_ = rankingType;}
   int getFindBestComplexityRankingType() {return findBestComplexityRankingType_;}
 
+  void addFindBestComplexityParametric(bool parametric) {findBestComplexityParametric_ = parametric;}
+  bool getFindBestComplexityParametric() {return findBestComplexityParametric_;}
+
   void addAlphaConvexCombinationModel3(double alphaConvexCombinationModel3) {alphaConvexCombinationModel3_ = alphaConvexCombinationModel3;}
   double getAlphaConvexCombinationModel3() {return alphaConvexCombinationModel3_;}
 
@@ -158,6 +178,54 @@ public:
   void addSpeedUpComputationNegK(bool speedUpComputationNegK) {speedUpComputationNegK_ = speedUpComputationNegK;}
   bool getSpeedUpComputationNegK() {return speedUpComputationNegK_;}
 
+  void addNegKEstimator(bool negKEstimator) {negKEstimator_ = negKEstimator;}
+  bool getNegKEstimator() {return negKEstimator_;}
+
+  void addNegKRelativeError(double negKRelativeError) {negKRelativeError_ = negKRelativeError;}
+  double getNegKRelativeError() {return negKRelativeError_;}
+
+  void addNegKMinSample(int negKMinSample) {negKMinSample_ = negKMinSample;}
+  int getNegKMinSample() {return negKMinSample_;}
+
+  void addBatchExtraCoverage(bool batchExtraCoverage) {batchExtraCoverage_ = batchExtraCoverage;}
+  bool getBatchExtraCoverage() {return batchExtraCoverage_;}
+
+  void addPathCountColumn(bool pathCountColumn) {pathCountColumn_ = pathCountColumn;}
+  bool getPathCountColumn() {return pathCountColumn_;}
+
+  void addPathCountMax(int pathCountMax) {pathCountMax_ = pathCountMax;}
+  int getPathCountMax() {return pathCountMax_;}
+
+  void addPlanRuleWalks(bool planRuleWalks) {planRuleWalks_ = planRuleWalks;}
+  bool getPlanRuleWalks() {return planRuleWalks_;}
+
+  void addNumberThreads(int numberThreads) {numberThreads_ = numberThreads;}
+  int getNumberThreads() {return numberThreads_;}
+
+  void addNumberParallelRelations(int numberParallelRelations) {numberParallelRelations_ = numberParallelRelations;}
+  int getNumberParallelRelations() {return numberParallelRelations_;}
+
+  void addLargeLPMinColumns(int largeLPMinColumns) {largeLPMinColumns_ = largeLPMinColumns;}
+  int getLargeLPMinColumns() {return largeLPMinColumns_;}
+
+  void addLargeLPAlgorithm(int largeLPAlgorithm) {largeLPAlgorithm_ = largeLPAlgorithm;}
+  int getLargeLPAlgorithm() {return largeLPAlgorithm_;}
+
+  void addDualSmoothingAlpha(double dualSmoothingAlpha) {dualSmoothingAlpha_ = dualSmoothingAlpha;}
+  double getDualSmoothingAlpha() {return dualSmoothingAlpha_;}
+
+  void addColumnGenerationGapTolerance(double columnGenerationGapTolerance) {columnGenerationGapTolerance_ = columnGenerationGapTolerance;}
+  double getColumnGenerationGapTolerance() {return columnGenerationGapTolerance_;}
+
+  void addRuleCacheSizeMB(int ruleCacheSizeMB) {ruleCacheSizeMB_ = ruleCacheSizeMB;}
+  int getRuleCacheSizeMB() {return ruleCacheSizeMB_;}
+
+  void addWriteProfile(bool writeProfile) {writeProfile_ = writeProfile;}
+  bool getWriteProfile() {return writeProfile_;}
+
+  void addWriteTrace(bool writeTrace) {writeTrace_ = writeTrace;}
+  bool getWriteTrace() {return writeTrace_;}
+
 };
 
 #endif
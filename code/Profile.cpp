@@ -0,0 +1,122 @@
+// © Copyright IBM Corporation 2022. All Rights Reserved.
+// LICENSE: Eclipse Public License - v 2.0, https://opensource.org/licenses/EPL-2.0
+// SPDX-License-Identifier: EPL-2.0
+
+#include "Profile.hpp"
+
+#include <iomanip>
+#include <cstdio>
+
+using namespace std;
+
+thread_local Profile* Profile::current_ = NULL;
+thread_local long long Profile::localCounters_[Profile::NUM_COUNTERS] = {0};
+
+const char* Profile::getPhaseName(Phase phase)
+{
+  static const char* names[NUM_PHASES] =
+    {"total", "data_loading", "query_setup",
+     "generate_rules", "generate_rules_s0", "generate_rules_s2",
+     "generate_rules_heuristic", "generate_rules_s0_duals",
+     "column_building", "pricing", "lp_solve", "validation",
+     "test_scoring"};
+  return names[phase];
+}
+
+const char* Profile::getCounterName(Counter counter)
+{
+  static const char* names[NUM_COUNTERS] =
+    {"dfs_nodes_expanded", "bfs_nodes_expanded", "edges_scanned",
+     "rules_evaluated", "planned_walks", "planned_backward_walks",
+     "planned_bfs_walks", "planned_nodes_estimated",
+     "planned_nodes_expanded"};
+  return names[counter];
+}
+
+void Profile::reset()
+{
+  for(int i=0; i<NUM_PHASES; i++) {
+    nanoseconds_[i] = 0;
+    calls_[i] = 0;
+  }
+  for(int i=0; i<NUM_COUNTERS; i++)
+    counters_[i] = 0;
+}
+
+void Profile::addTime(Phase phase, long long nanoseconds)
+{
+  nanoseconds_[phase].fetch_add(nanoseconds, memory_order_relaxed);
+  calls_[phase].fetch_add(1, memory_order_relaxed);
+}
+
+void Profile::setCurrent(Profile* profile)
+{
+  flushCounters();
+  current_ = profile;
+}
+
+void Profile::flushCounters()
+{
+  for(int i=0; i<NUM_COUNTERS; i++) {
+    if(current_ && localCounters_[i] != 0)
+      current_->counters_[i].fetch_add(localCounters_[i], memory_order_relaxed);
+    localCounters_[i] = 0;
+  }
+}
+
+// Writes the phases and counters as the members of a JSON object,
+// without the braces, each line starting with indent
+void Profile::writeJSON(ostream& out, string indent)
+{
+  out<<indent<<"\"phases\": {"<<endl;
+  for(int i=0; i<NUM_PHASES; i++) {
+    Phase phase = (Phase)i;
+    out<<indent<<"  \""<<getPhaseName(phase)<<"\": {\"seconds\": "
+       <<setprecision(6)<<fixed<<getSeconds(phase)
+       <<", \"calls\": "<<getCalls(phase)<<"}";
+    if(i+1 < NUM_PHASES)
+      out<<",";
+    out<<endl;
+  }
+  out<<indent<<"},"<<endl;
+  out<<indent<<"\"counters\": {"<<endl;
+  for(int i=0; i<NUM_COUNTERS; i++) {
+    Counter counter = (Counter)i;
+    out<<indent<<"  \""<<getCounterName(counter)<<"\": "<<getCounter(counter);
+    if(i+1 < NUM_COUNTERS)
+      out<<",";
+    out<<endl;
+  }
+  out<<indent<<"}"<<endl;
+  out.unsetf(ios_base::floatfield);
+}
+
+void ScopedTimer::stop()
+{
+  if(!profile_)
+    return;
+  chrono::nanoseconds elapsed = chrono::steady_clock::now() - start_;
+  profile_->addTime(phase_, elapsed.count());
+  Profile::flushCounters();
+  profile_ = NULL;
+}
+
+string escapeJSON(const string& s)
+{
+  string out;
+  for(int i=0; i<(int)s.size(); i++) {
+    char c = s[i];
+    if(c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    }
+    else if((unsigned char)c < 0x20) {
+      char buf[8];
+      snprintf(buf, sizeof(buf), "\\u%04x", (unsigned char)c);
+      out += buf;
+    }
+    else
+      out += c;
+  }
+  return out;
+}
@@ -0,0 +1,97 @@
+// © Copyright IBM Corporation 2022. All Rights Reserved.
+// LICENSE: Eclipse Public License - v 2.0, https://opensource.org/licenses/EPL-2.0
+// SPDX-License-Identifier: EPL-2.0
+
+#ifndef __PROFILE_HPP__
+#define __PROFILE_HPP__
+
+#include <iostream>
+#include <string>
+#include <atomic>
+#include <chrono>
+
+using namespace std;
+
+// Wall time spent in each phase of a relation and counters of the work
+// done by the path searches. A profile receives the timers and counters
+// of a thread once it is made current with setCurrent() or
+// ScopedProfile; when no profile is current they only test a thread
+// local pointer. The counters are accumulated in thread local variables
+// and added to the profile when a timer ends or the profile stops being
+// current, so the searches pay a plain increment per node. The times of
+// nested phases are inclusive (e.g. the LP solves inside a validation
+// sweep are counted in both).
+class Profile {
+public:
+  enum Phase {TOTAL, DATA_LOADING, QUERY_SETUP,
+	      GENERATE_RULES, GENERATE_RULES_S0, GENERATE_RULES_S2,
+	      GENERATE_RULES_HEURISTIC, GENERATE_RULES_S0_DUALS,
+	      COLUMN_BUILDING, PRICING, LP_SOLVE, VALIDATION,
+	      TEST_SCORING, NUM_PHASES};
+  enum Counter {DFS_NODES_EXPANDED, BFS_NODES_EXPANDED, EDGES_SCANNED,
+		RULES_EVALUATED, PLANNED_WALKS, PLANNED_BACKWARD_WALKS,
+		PLANNED_BFS_WALKS, PLANNED_NODES_ESTIMATED,
+		PLANNED_NODES_EXPANDED, NUM_COUNTERS};
+
+private:
+  atomic<long long> nanoseconds_[NUM_PHASES];
+  atomic<long long> calls_[NUM_PHASES];
+  atomic<long long> counters_[NUM_COUNTERS];
+
+  static thread_local Profile* current_;
+  static thread_local long long localCounters_[NUM_COUNTERS];
+
+public:
+  Profile() {reset();}
+  ~Profile() {}
+
+  static const char* getPhaseName(Phase phase);
+  static const char* getCounterName(Counter counter);
+
+  void reset();
+  void addTime(Phase phase, long long nanoseconds);
+  double getSeconds(Phase phase) {return 1.0e-9*nanoseconds_[phase];}
+  long long getCalls(Phase phase) {return calls_[phase];}
+  long long getCounter(Counter counter) {return counters_[counter];}
+  void writeJSON(ostream& out, string indent);
+
+  static Profile* getCurrent() {return current_;}
+  static void setCurrent(Profile* profile);
+  static void flushCounters(); // adds the counters of this thread to the current profile
+  static void count(Counter counter, long long n=1)
+  {if(current_) localCounters_[counter] += n;}
+  // not yet flushed, 0 when no profile is current
+  static long long getLocalCounter(Counter counter) {return localCounters_[counter];}
+};
+
+// Adds the wall time of the enclosing scope, or until stop() is called,
+// to a phase of the profile that is current when the scope starts
+class ScopedTimer {
+private:
+  Profile* profile_;
+  Profile::Phase phase_;
+  chrono::steady_clock::time_point start_;
+
+public:
+  ScopedTimer(Profile::Phase phase):profile_(Profile::getCurrent()),phase_(phase)
+  {if(profile_) start_ = chrono::steady_clock::now();}
+  ~ScopedTimer() {stop();}
+
+  void stop();
+};
+
+// Makes a profile current for the enclosing scope, e.g. in each thread
+// of a parallel loop. profile can be NULL to disable profiling.
+class ScopedProfile {
+private:
+  Profile* previous_;
+
+public:
+  ScopedProfile(Profile* profile):previous_(Profile::getCurrent())
+  {Profile::setCurrent(profile);}
+  ~ScopedProfile() {Profile::setCurrent(previous_);}
+};
+
+string escapeJSON(const string& s);
+
+#endif
@@ -0,0 +1,123 @@
+// © Copyright IBM Corporation 2022. All Rights Reserved.
+// LICENSE: Eclipse Public License - v 2.0, https://opensource.org/licenses/EPL-2.0
+// SPDX-License-Identifier: EPL-2.0
+
+#include "QueryEngine.hpp"
+#include "RankStatistics.hpp"
+
+#include <cassert>
+
+using namespace std;
+
+QueryEngine::QueryEngine(Data& data, bool useBFS)
+  :data_(data),useBFS_(useBFS)
+{
+  int numRelations = data_.getNumberRelations();
+  tailRules_.resize(numRelations);
+  headRules_.resize(numRelations);
+  numRules_.resize(numRelations, 0);
+  int numEntities = (int)data_.getEntities().size();
+  scores_.resize(numEntities, 0.0);
+  isTouched_.resize(numEntities, false);
+}
+
+int QueryEngine::readRulesFile(string fname)
+{
+  ifstream infile(fname.c_str());
+  if(!infile) {
+    cerr<<"Cannot open rules file "<<fname<<endl;
+    return 0;
+  }
+
+  int numRules = 0;
+  string s;
+  while (getline( infile, s )) {
+    WeightedRule wrule;
+    int relationId;
+    bool isReverseHead;
+    if(!data_.parseRuleLine(s, wrule.weight, relationId, isReverseHead, wrule.rule))
+      continue;
+    // r(A,X) <= path from A to X: tails are reached walking forward
+    // from the head and heads walking backward from the tail.
+    // r(X,A) <= path from A to X is the same path read in reverse.
+    WeightedRule wruleHead = wrule;
+    wrule.walkForward = !isReverseHead;
+    wruleHead.walkForward = isReverseHead;
+    addRule(tailRules_[relationId], wrule);
+    addRule(headRules_[relationId], wruleHead);
+    numRules_[relationId] += 2;
+    numRules++;
+  }
+  infile.close();
+
+  return numRules;
+}
+
+// Adds the rule to the group of the first step of its walk from the
+// query entity, in the order of the rules file within the group
+void QueryEngine::addRule(vector<RuleGroup>& groups, WeightedRule& wrule)
+{
+  int len = wrule.rule.getLengthRule();
+  int pos = wrule.walkForward ? 0 : len-1;
+  int relId = wrule.rule.getRelationIds()[pos];
+  bool isReverseArc = wrule.rule.getIsReverseArc()[pos];
+  bool useInArcs = (wrule.walkForward == isReverseArc);
+  int g = 0;
+  while(g < (int)groups.size() &&
+	(groups[g].firstRelationId != relId || groups[g].useInArcs != useInArcs))
+    g++;
+  if(g == (int)groups.size()) {
+    groups.push_back(RuleGroup());
+    groups[g].firstRelationId = relId;
+    groups[g].useInArcs = useInArcs;
+  }
+  groups[g].rules.push_back(wrule);
+}
+
+void QueryEngine::score(vector<RuleGroup>& groups, int entityId, int k,
+			vector<pair<int,double> >& results)
+{
+  static thread_local vector<int> ids;
+  for(int g=0; g<(int)groups.size(); g++) {
+    RuleGroup& group = groups[g];
+    vector<vector<bool> >& hasArc = group.useInArcs ? data_.getRelationNodeHasInvArc() : data_.getRelationNodeHasArc();
+    if(!hasArc[group.firstRelationId][entityId])
+      continue;
+    for(int j=0; j<(int)group.rules.size(); j++) {
+      WeightedRule& wrule = group.rules[j];
+      if(wrule.walkForward)
+	data_.getRightEntities(wrule.rule, entityId, ids, useBFS_);
+      else
+	data_.getLeftEntities(wrule.rule, entityId, ids, useBFS_);
+      for(int l=0; l<(int)ids.size(); l++) {
+	scores_[ids[l]] += wrule.weight;
+	if(!isTouched_[ids[l]]) {
+	  isTouched_[ids[l]] = true;
+	  touched_.push_back(ids[l]);
+	}
+      }
+    }
+  }
+
+  selectTopK(scores_, touched_, k, entityId, results);
+
+  for(int t=0; t<(int)touched_.size(); t++) {
+    scores_[touched_[t]] = 0.0;
+    isTouched_[touched_[t]] = false;
+  }
+  touched_.clear();
+}
+
+void QueryEngine::queryTails(int headId, int relationId, int k,
+			     vector<pair<int,double> >& results)
+{
+  assert(relationId >= 0 && relationId < (int)tailRules_.size());
+  score(tailRules_[relationId], headId, k, results);
+}
+
+void QueryEngine::queryHeads(int tailId, int relationId, int k,
+			     vector<pair<int,double> >& results)
+{
+  assert(relationId >= 0 && relationId < (int)headRules_.size());
+  score(headRules_[relationId], tailId, k, results);
+}
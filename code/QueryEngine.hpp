@@ -0,0 +1,62 @@
+// © Copyright IBM Corporation 2022. All Rights Reserved.
+// LICENSE: Eclipse Public License - v 2.0, https://opensource.org/licenses/EPL-2.0
+// SPDX-License-Identifier: EPL-2.0
+
+#ifndef __QUERYENGINE_HPP__
+#define __QUERYENGINE_HPP__
+
+#include "Data.hpp"
+
+#include <vector>
+#include <string>
+
+using namespace std;
+
+// Answers link prediction queries (h, r, ?) and (?, r, t) with the rules
+// learned by LPRules. The rules of each relation are indexed by the side
+// of the query they answer and by the first step of their walk from the
+// query entity, so a query skips the rules whose first step has no arc
+// at its entity without looking at them. Not thread safe: the score
+// buffers are reused between queries.
+class QueryEngine {
+private:
+  struct WeightedRule {
+    Rule rule;
+    double weight;
+    bool walkForward; // true if the rule is applied with getRightEntities from the query entity
+  };
+
+  // the rules whose walk starts with an arc of the relation leaving
+  // the query entity, or entering it if useInArcs
+  struct RuleGroup {
+    int firstRelationId;
+    bool useInArcs;
+    vector<WeightedRule> rules;
+  };
+
+  Data& data_;
+  bool useBFS_;
+  vector<vector<RuleGroup> > tailRules_; // per relation, rules answering (h, r, ?)
+  vector<vector<RuleGroup> > headRules_; // per relation, rules answering (?, r, t)
+  vector<int> numRules_; // per relation
+  vector<double> scores_;
+  vector<bool> isTouched_;
+  vector<int> touched_;
+
+  void addRule(vector<RuleGroup>& groups, WeightedRule& wrule);
+  void score(vector<RuleGroup>& groups, int entityId, int k,
+	     vector<pair<int,double> >& results);
+
+public:
+  QueryEngine(Data& data, bool useBFS);
+  ~QueryEngine() {}
+
+  int readRulesFile(string fname); // returns the number of rules read
+  int getNumRules(int relationId) {return numRules_[relationId];}
+
+  // top-k entities with positive score, best first, ties by entity id
+  void queryTails(int headId, int relationId, int k, vector<pair<int,double> >& results);
+  void queryHeads(int tailId, int relationId, int k, vector<pair<int,double> >& results);
+};
+
+#endif
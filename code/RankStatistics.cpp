@@ -0,0 +1,145 @@
+// © Copyright IBM Corporation 2022. All Rights Reserved.
+// LICENSE: Eclipse Public License - v 2.0, https://opensource.org/licenses/EPL-2.0
+// SPDX-License-Identifier: EPL-2.0
+
+#include "RankStatistics.hpp"
+
+#include <cassert>
+#include <queue>
+#include <algorithm>
+
+using namespace std;
+
+void RankStatistics::compute(double basescore, vector<double>& scores,
+			     vector<int>& touched, int entity1, int entity2,
+			     vector<int>& filtered)
+{
+  basescore_ = basescore;
+  numGreaterRaw_ = 0;
+  numEqualRaw_ = 0;
+  numGreaterFiltered_ = 0;
+  numEqualFiltered_ = 0;
+  tiedFiltered_.clear();
+  tiedOnlyRaw_.clear();
+  numZeroTiesFiltered_ = 0;
+  numZeroTiesOnlyRaw_ = 0;
+
+  int numPairEntities = (entity1 == entity2) ? 1 : 2;
+  int numCandidatesRaw = numEntities_ - numPairEntities;
+
+  int numFiltered = 0; // filtered entities that are candidates
+  for(int i=0; i<(int)filtered.size(); i++) {
+    int id = filtered[i];
+    if(!isFiltered_[id]) {
+      isFiltered_[id] = true;
+      if(id != entity1 && id != entity2)
+	numFiltered++;
+    }
+  }
+  int numCandidatesFiltered = numCandidatesRaw - numFiltered;
+
+  int numTouchedRaw = 0;
+  int numTouchedFiltered = 0;
+  for(int t=0; t<(int)touched.size(); t++) {
+    int k = touched[t];
+    if(k == entity1 || k == entity2)
+      continue;
+    double score = scores[k];
+    bool isCandidate = !isFiltered_[k];
+    numTouchedRaw++;
+    if(isCandidate)
+      numTouchedFiltered++;
+    if(score > basescore) {
+      numGreaterRaw_++;
+      if(isCandidate)
+	numGreaterFiltered_++;
+    }
+    else if(score == basescore) {
+      numEqualRaw_++;
+      if(isCandidate) {
+	numEqualFiltered_++;
+	tiedFiltered_.push_back(k);
+      }
+      else
+	tiedOnlyRaw_.push_back(k);
+    }
+  }
+
+  // the entities that were not touched score zero
+  int numZeroRaw = numCandidatesRaw - numTouchedRaw;
+  int numZeroFiltered = numCandidatesFiltered - numTouchedFiltered;
+  if(0.0 > basescore) {
+    numGreaterRaw_ += numZeroRaw;
+    numGreaterFiltered_ += numZeroFiltered;
+  }
+  else if(0.0 == basescore) {
+    numEqualRaw_ += numZeroRaw;
+    numEqualFiltered_ += numZeroFiltered;
+    numZeroTiesFiltered_ = numZeroFiltered;
+    numZeroTiesOnlyRaw_ = numZeroRaw - numZeroFiltered;
+  }
+
+  for(int i=0; i<(int)filtered.size(); i++)
+    isFiltered_[filtered[i]] = false;
+}
+
+int RankStatistics::getRank(int rankingType, bool filtered)
+{
+  int numGreater = getNumGreater(filtered);
+  int numEqual = getNumEqual(filtered);
+
+  if(rankingType==0 || rankingType==4)
+    return 1 + numGreater;
+  if(rankingType==2)
+    return 1 + numGreater + numEqual;
+  if(rankingType==1) {
+    if(basescore_ > 0.0)
+      return 1 + numGreater;
+    if(basescore_ == 0.0)
+      return 1 + numGreater + numEqual;
+    return 1;
+  }
+
+  assert(false); // the random break has to be done by the caller
+  return 1;
+}
+
+// orders (entity, score) with the best result first
+struct BetterResult {
+  bool operator()(const pair<int,double>& a, const pair<int,double>& b) const
+  {
+    if(a.second != b.second)
+      return a.second > b.second;
+    return a.first < b.first;
+  }
+};
+
+void selectTopK(vector<double>& scores, vector<int>& touched, int k,
+		int skipEntity, vector<pair<int,double> >& results)
+{
+  results.clear();
+  if(k <= 0)
+    return;
+
+  // bounded heap with the worst of the current top-k on top
+  priority_queue<pair<int,double>, vector<pair<int,double> >, BetterResult> heap;
+  BetterResult better;
+  for(int t=0; t<(int)touched.size(); t++) {
+    int id = touched[t];
+    pair<int,double> candidate(id, scores[id]);
+    if(id == skipEntity || candidate.second <= 0.0)
+      continue;
+    if((int)heap.size() < k)
+      heap.push(candidate);
+    else if(better(candidate, heap.top())) {
+      heap.pop();
+      heap.push(candidate);
+    }
+  }
+
+  while(!heap.empty()) {
+    results.push_back(heap.top());
+    heap.pop();
+  }
+  reverse(results.begin(), results.end());
+}
@@ -0,0 +1,61 @@
+// © Copyright IBM Corporation 2022. All Rights Reserved.
+// LICENSE: Eclipse Public License - v 2.0, https://opensource.org/licenses/EPL-2.0
+// SPDX-License-Identifier: EPL-2.0
+
+#ifndef __RANKSTATISTICS_HPP__
+#define __RANKSTATISTICS_HPP__
+
+#include <vector>
+
+using namespace std;
+
+// Rank of the target entity of a test pair from sparse scores: only the
+// touched entities can have a nonzero score, and every other entity is
+// counted in bulk as a score of zero. For each of the raw and filtered
+// rankings it counts the candidates that score above and equal to the
+// target. The candidates are all entities but the two entities of the
+// pair, and the filtered ranking also leaves out the given entities.
+// The work is proportional to the number of touched and filtered
+// entities, not to the number of entities.
+class RankStatistics {
+private:
+  int numEntities_;
+  vector<bool> isFiltered_; // scratch, all false between calls
+  int numGreaterRaw_;
+  int numEqualRaw_;
+  int numGreaterFiltered_;
+  int numEqualFiltered_;
+  double basescore_;
+  vector<int> tiedFiltered_; // touched entities tied with the target in both rankings
+  vector<int> tiedOnlyRaw_; // touched entities tied with the target only in the raw ranking
+  int numZeroTiesFiltered_; // untouched entities tied with the target in both rankings
+  int numZeroTiesOnlyRaw_;
+
+public:
+  RankStatistics(int numEntities)
+    :numEntities_(numEntities),isFiltered_(numEntities,false),
+     numGreaterRaw_(0),numEqualRaw_(0),numGreaterFiltered_(0),numEqualFiltered_(0),
+     basescore_(0.0),numZeroTiesFiltered_(0),numZeroTiesOnlyRaw_(0) {}
+  ~RankStatistics() {}
+
+  void compute(double basescore, vector<double>& scores, vector<int>& touched,
+	       int entity1, int entity2, vector<int>& filtered);
+
+  int getNumGreater(bool filtered) {return filtered ? numGreaterFiltered_ : numGreaterRaw_;}
+  int getNumEqual(bool filtered) {return filtered ? numEqualFiltered_ : numEqualRaw_;}
+  // the ties split into the ones in both rankings and the ones only in
+  // the raw ranking, as entities for the touched ones and as a count
+  // for the untouched ones (which all score zero)
+  vector<int>& getTiedEntities(bool inBoth) {return inBoth ? tiedFiltered_ : tiedOnlyRaw_;}
+  int getNumZeroTies(bool inBoth) {return inBoth ? numZeroTiesFiltered_ : numZeroTiesOnlyRaw_;}
+  // rank for the deterministic ranking types: 0 (and 4) is aggressive,
+  // 1 is intermediate, 2 is conservative
+  int getRank(int rankingType, bool filtered);
+};
+
+// Entities with the k largest positive scores among the touched ones,
+// best first, ties by entity id
+void selectTopK(vector<double>& scores, vector<int>& touched, int k,
+		int skipEntity, vector<pair<int,double> >& results);
+
+#endif
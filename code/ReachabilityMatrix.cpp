@@ -0,0 +1,55 @@
+// © Copyright IBM Corporation 2022. All Rights Reserved.
+// LICENSE: Eclipse Public License - v 2.0, https://opensource.org/licenses/EPL-2.0
+// SPDX-License-Identifier: EPL-2.0
+
+#include "ReachabilityMatrix.hpp"
+
+#include <cassert>
+#include <cstddef>
+
+using namespace std;
+
+// values is NULL for a 0/1 column, and must be so for every column
+void ReachabilityMatrix::addRule(int ruleId, const int* entities,
+				 const double* values, int numEntities)
+{
+  assert(!hasRule(ruleId));
+  assert(values ? values_.size() == rowIndices_.size() : values_.empty());
+  if(values)
+    values_.insert(values_.end(), values, values+numEntities);
+  if(ruleId >= (int)columnOfRule_.size())
+    columnOfRule_.resize(ruleId+1, -1);
+  columnOfRule_[ruleId] = getNumColumns();
+  rowIndices_.insert(rowIndices_.end(), entities, entities+numEntities);
+  columnStart_.push_back((int)rowIndices_.size());
+}
+
+void ReachabilityMatrix::multiply(const int* ruleIds, const double* weights,
+				  int numRules, vector<double>& scores,
+				  vector<int>& touched, vector<bool>& isTouched)
+{
+  for(int j=0; j<numRules; j++) {
+    assert(hasRule(ruleIds[j]));
+    int col = columnOfRule_[ruleIds[j]];
+    double weight = weights[j];
+    for(int k=columnStart_[col]; k<columnStart_[col+1]; k++) {
+      int row = rowIndices_[k];
+      scores[row] += values_.empty() ? weight : weight*values_[k];
+      if(!isTouched[row]) {
+	isTouched[row] = true;
+	touched.push_back(row);
+      }
+    }
+  }
+}
+
+ReachabilityMatrix& ReachabilityMatrices::get(int entityId)
+{
+  int m = matrixOfEntity_[entityId];
+  if(m < 0) {
+    m = (int)matrices_.size();
+    matrixOfEntity_[entityId] = m;
+    matrices_.push_back(ReachabilityMatrix());
+  }
+  return matrices_[m];
+}
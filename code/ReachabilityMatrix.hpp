@@ -0,0 +1,59 @@
+// © Copyright IBM Corporation 2022. All Rights Reserved.
+// LICENSE: Eclipse Public License - v 2.0, https://opensource.org/licenses/EPL-2.0
+// SPDX-License-Identifier: EPL-2.0
+
+#ifndef __REACHABILITYMATRIX_HPP__
+#define __REACHABILITYMATRIX_HPP__
+
+#include <vector>
+
+using namespace std;
+
+// Sparse 0/1 matrix for one anchor entity, with a row per entity and a
+// column per rule: a_ij = 1 if rule j reaches entity i from the anchor,
+// or the value given for it (e.g. of its number of paths). Columns are stored compressed (CSC) and added lazily as rules get
+// selected, so the scores of a set of rule weights are a sparse
+// matrix-vector product instead of a graph traversal.
+class ReachabilityMatrix {
+private:
+  vector<int> columnOfRule_; // by rule id, -1 if the rule has no column
+  vector<int> columnStart_; // rows of column j are rowIndices_[columnStart_[j]..columnStart_[j+1])
+  vector<int> rowIndices_;
+  vector<double> values_; // empty if the columns are 0/1
+
+public:
+  ReachabilityMatrix() {columnStart_.push_back(0);}
+  ~ReachabilityMatrix() {}
+
+  bool hasRule(int ruleId)
+  {return ruleId < (int)columnOfRule_.size() && columnOfRule_[ruleId] >= 0;}
+  void addRule(int ruleId, const int* entities, const double* values,
+	       int numEntities);
+  int getNumColumns() {return (int)columnStart_.size()-1;}
+  int getNumNonZeros() {return (int)rowIndices_.size();}
+
+  // scores += A * weights over the given rules. Every entity reached by
+  // one of the rules is appended once to touched, using isTouched (of
+  // the size of scores and false on entry) to mark them.
+  void multiply(const int* ruleIds, const double* weights, int numRules,
+		vector<double>& scores, vector<int>& touched,
+		vector<bool>& isTouched);
+};
+
+// Reachability matrices of the anchor entities of the validation pairs,
+// found through a flat index by entity. They are kept while the rules
+// do not change, e.g. during a sweep of the complexity.
+class ReachabilityMatrices {
+private:
+  vector<int> matrixOfEntity_; // -1 if the entity has no matrix yet
+  vector<ReachabilityMatrix> matrices_;
+
+public:
+  ReachabilityMatrices(int numEntities):matrixOfEntity_(numEntities, -1) {}
+  ~ReachabilityMatrices() {}
+
+  // the reference is valid until the next call
+  ReachabilityMatrix& get(int entityId);
+};
+
+#endif
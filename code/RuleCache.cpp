@@ -0,0 +1,97 @@
+// © Copyright IBM Corporation 2022. All Rights Reserved.
+// LICENSE: Eclipse Public License - v 2.0, https://opensource.org/licenses/EPL-2.0
+// SPDX-License-Identifier: EPL-2.0
+
+#include "RuleCache.hpp"
+
+#include <iostream>
+
+using namespace std;
+
+size_t RuleCache::KeyHash::operator()(const Key& k) const
+{
+  size_t h = (size_t)k.relationId;
+  h = h * 1000003 + (size_t)k.ruleId;
+  h = h * 1000003 + (size_t)k.entityId;
+  h = h * 2 + (size_t)k.side;
+  return h;
+}
+
+void RuleCache::setMaxBytes(size_t maxBytes)
+{
+  lock_guard<mutex> lock(mutex_);
+  maxBytes_ = maxBytes;
+  evict();
+}
+
+shared_ptr<const vector<int> > RuleCache::find(int relationId, int ruleId,
+					       int entityId, int side)
+{
+  if(maxBytes_ == 0)
+    return shared_ptr<const vector<int> >();
+
+  Key key = {relationId, ruleId, entityId, side};
+  lock_guard<mutex> lock(mutex_);
+  unordered_map<Key, list<Entry>::iterator, KeyHash>::iterator it = index_.find(key);
+  if(it == index_.end()) {
+    misses_++;
+    return shared_ptr<const vector<int> >();
+  }
+  hits_++;
+  entries_.splice(entries_.begin(), entries_, it->second);
+  return it->second->entities;
+}
+
+void RuleCache::insert(int relationId, int ruleId, int entityId, int side,
+		       shared_ptr<const vector<int> > entities)
+{
+  if(maxBytes_ == 0)
+    return;
+
+  Key key = {relationId, ruleId, entityId, side};
+  // the entities plus the list node and the hash table node
+  size_t bytes = entities->capacity()*sizeof(int) + sizeof(Entry) + sizeof(Key) + 4*sizeof(void*);
+  if(bytes > maxBytes_)
+    return;
+
+  lock_guard<mutex> lock(mutex_);
+  if(index_.find(key) != index_.end())
+    return; // another thread got here first
+  Entry entry = {key, entities, bytes};
+  entries_.push_front(entry);
+  index_[key] = entries_.begin();
+  bytes_ += bytes;
+  evict();
+}
+
+void RuleCache::evict()
+{
+  while(bytes_ > maxBytes_ && !entries_.empty()) {
+    Entry& entry = entries_.back();
+    bytes_ -= entry.bytes;
+    index_.erase(entry.key);
+    entries_.pop_back();
+    evictions_++;
+  }
+}
+
+void RuleCache::clearRelation(int relationId)
+{
+  lock_guard<mutex> lock(mutex_);
+  list<Entry>::iterator it = entries_.begin();
+  while(it != entries_.end()) {
+    if(it->key.relationId == relationId) {
+      bytes_ -= it->bytes;
+      index_.erase(it->key);
+      it = entries_.erase(it);
+    }
+    else
+      it++;
+  }
+}
+
+void RuleCache::printStatistics()
+{
+  lock_guard<mutex> lock(mutex_);
+  cout<<"Rule cache: hits "<<hits_<<", misses "<<misses_<<", evictions "<<evictions_<<", entries "<<entries_.size()<<", MB used "<<bytes_/(1024.0*1024.0)<<" of "<<maxBytes_/(1024.0*1024.0)<<endl;
+}
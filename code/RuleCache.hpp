@@ -0,0 +1,67 @@
+// © Copyright IBM Corporation 2022. All Rights Reserved.
+// LICENSE: Eclipse Public License - v 2.0, https://opensource.org/licenses/EPL-2.0
+// SPDX-License-Identifier: EPL-2.0
+
+#ifndef __RULECACHE_HPP__
+#define __RULECACHE_HPP__
+
+#include <list>
+#include <unordered_map>
+#include <vector>
+#include <memory>
+#include <mutex>
+
+using namespace std;
+
+// Least recently used cache of the entities reached by applying a rule
+// from an entity. An entry is keyed by the relation, the index of the
+// rule in the rules of that relation, the entity, and the side (right
+// gives the destinations of a head, left the origins of a tail). The
+// entities are kept as sorted arrays, and the cache evicts entries once
+// their total size goes over maxBytes. maxBytes = 0 disables the cache.
+class RuleCache {
+private:
+  struct Key {
+    int relationId;
+    int ruleId;
+    int entityId;
+    int side;
+    bool operator==(const Key& k) const {return relationId==k.relationId && ruleId==k.ruleId && entityId==k.entityId && side==k.side;}
+  };
+  struct KeyHash {
+    size_t operator()(const Key& k) const;
+  };
+  struct Entry {
+    Key key;
+    shared_ptr<const vector<int> > entities;
+    size_t bytes;
+  };
+
+  mutex mutex_;
+  size_t maxBytes_;
+  size_t bytes_;
+  list<Entry> entries_; // most recently used first
+  unordered_map<Key, list<Entry>::iterator, KeyHash> index_;
+  long hits_;
+  long misses_;
+  long evictions_;
+
+  void evict();
+
+public:
+  RuleCache(size_t maxBytes=0):maxBytes_(maxBytes),bytes_(0),hits_(0),misses_(0),evictions_(0) {}
+  ~RuleCache() {}
+
+  static const int RIGHT = 0;
+  static const int LEFT = 1;
+
+  void setMaxBytes(size_t maxBytes);
+  bool isEnabled() {return maxBytes_ > 0;}
+  shared_ptr<const vector<int> > find(int relationId, int ruleId, int entityId, int side);
+  void insert(int relationId, int ruleId, int entityId, int side,
+	      shared_ptr<const vector<int> > entities);
+  void clearRelation(int relationId);
+  void printStatistics();
+};
+
+#endif
@@ -7,6 +7,7 @@
 //#include <iostream>
 #include <iomanip>
 #include <list>
+#include <cmath>
 
 using namespace std;
 
@@ -26,9 +27,18 @@ void Solver::setMinPercentCoverage(double minCov)
 
 void Solver::run(string scoresFileName, string rulesFileName, string inputRulesFileName)
 {
-  srand(1234); // initialize random generator
 
-  data_.readData(params_);
+  bool writeProfile = params_.getWriteProfile();
+  if(params_.getWriteTrace())
+    Trace::enable();
+  {
+    ScopedProfile scopedProfile(writeProfile ? &runProfile_ : NULL);
+    data_.readData(params_);
+    ScopedTimer timer(Profile::DATA_LOADING);
+    knownFacts_.build(data_);
+    if(params_.getNegKEstimator())
+      buildSampleOrders();
+  }
 
   bool runForReverseRelations = params_.getRunForReverseRelations();
   int numrelations = data_.getNumberRelations();
@@ -39,11 +49,8 @@ void Solver::run(string scoresFileName, string rulesFileName, string inputRulesF
   rulesweights_.resize(numrelations);
 
   int sizeRankings = numrelations;
-  int timesToRunInnerLoop = 1;
-  if(runForReverseRelations) {
+  if(runForReverseRelations)
     sizeRankings *= 2;
-    timesToRunInnerLoop = 2;
-  }
   rankings_.resize(sizeRankings, Rankings(5));
   rankingsAggressiveRightRaw_.resize(sizeRankings);
   rankingsAggressiveRightFiltered_.resize(sizeRankings);
@@ -62,12 +69,22 @@ void Solver::run(string scoresFileName, string rulesFileName, string inputRulesF
   rankingsLeftRaw_.resize(sizeRankings);
   rankingsLeftFiltered_.resize(sizeRankings);
 
+  if(writeProfile) {
+    profiles_.resize(sizeRankings);
+    for(int i=0; i<sizeRankings; i++)
+      profiles_[i].reset(new Profile());
+  }
+
   int runMode = params_.getRunMode();
-  if(runMode > 0)
+  if(runMode > 0) {
+    ScopedProfile scopedProfile(writeProfile ? &runProfile_ : NULL);
+    ScopedTimer timer(Profile::DATA_LOADING);
     readRulesFromFile(inputRulesFileName);
+  }
 
   TestData& testdata = data_.getTestData();
 
+  vector<int> relationIds;
   for(int relationId=0; relationId<numrelations; relationId++) {
     if(params_.getRunOnlyWithRelationId() && relationId != params_.getRelationId()) continue;
 
@@ -76,30 +93,43 @@ void Solver::run(string scoresFileName, string rulesFileName, string inputRulesF
       if(numentitypairs == 0) continue;
     }
 
-    for(int iter=0; iter<timesToRunInnerLoop; iter++) {
-      int modifiedRelationId = relationId + iter * numrelations;
-      
-      if(runMode != 1) { // if runMode==1 then read rules from file and write statistics
-	if(runMode == 0) // if runMode>0, then read rules and so cannot clear
-	  rules_[modifiedRelationId].clear();
-	rulesadded_[modifiedRelationId].clear();
-	rulesselected_[modifiedRelationId].clear();
-	rulesweights_[modifiedRelationId].clear();
-
-	data_.createQueryFromTrainingData(modifiedRelationId);
-
-	if(params_.getRunColumnGeneration())
-	  runColumnGenerationOneRelation(modifiedRelationId);
-	else
-	  runOneRelation(modifiedRelationId);
-      }
-
-      writeScoresToFile(modifiedRelationId, scoresFileName);
-
-      writeRulesToFile(modifiedRelationId, rulesFileName);
-
-    }
+    relationIds.push_back(relationId);
+  }
+
+  int numParallelRelations = params_.getNumberParallelRelations();
+  if(numParallelRelations > (int)relationIds.size())
+    numParallelRelations = (int)relationIds.size();
+  if(numParallelRelations > 1) {
+    // start with the relations with more training pairs, so that
+    // the large relations do not end up running alone at the end
+    vector<pair<int,int> > sizes;
+    vector<int> numArcs(numrelations,0);
+    vector<Arc*>& arcs = data_.getArcs();
+    for(int i=0; i<(int)arcs.size(); i++)
+      numArcs[arcs[i]->getIdRelation()]++;
+    for(int i=0; i<(int)relationIds.size(); i++)
+      sizes.push_back(pair<int,int>(-numArcs[relationIds[i]],relationIds[i]));
+    sort(sizes.begin(),sizes.end());
+    for(int i=0; i<(int)sizes.size(); i++)
+      relationIds[i] = sizes[i].second;
+
+    atomic<int> nextRelation(0);
+    vector<thread> workers;
+    for(int i=0; i<numParallelRelations; i++)
+      workers.push_back(thread(&Solver::runRelationsWorker, this, ref(relationIds), ref(nextRelation), scoresFileName, rulesFileName));
+    for(int i=0; i<(int)workers.size(); i++)
+      workers[i].join();
   }
+  else {
+    atomic<int> nextRelation(0);
+    runRelationsWorker(relationIds, nextRelation, scoresFileName, rulesFileName);
+  }
+  if(ruleCache_.isEnabled())
+    ruleCache_.printStatistics();
+  if(writeProfile)
+    writeProfileToFile(scoresFileName+".profile.json");
+  if(params_.getWriteTrace())
+    Trace::writeToFile(scoresFileName+".trace.json");
 
   vector<vector<int> > rankingsAggressiveAllRaw(rankingsAggressiveRightRaw_.size()+rankingsAggressiveLeftRaw_.size());
   vector<vector<int> > rankingsAggressiveAllFiltered(rankingsAggressiveRightFiltered_.size()+rankingsAggressiveLeftFiltered_.size());
@@ -151,8 +181,94 @@ void Solver::run(string scoresFileName, string rulesFileName, string inputRulesF
 
 }
 
+void Solver::runRelationsWorker(vector<int>& relationIds,
+				atomic<int>& nextRelation,
+				string scoresFileName, string rulesFileName)
+{
+  int granted = threadBudget_.acquire(1);
+  while(true) {
+    int index = nextRelation++;
+    if(index >= (int)relationIds.size()) break;
+    runRelation(relationIds[index], scoresFileName, rulesFileName);
+  }
+  threadBudget_.release(granted);
+}
+
+void Solver::runRelation(int relationId, string scoresFileName, string rulesFileName)
+{
+  int numrelations = data_.getNumberRelations();
+  int runMode = params_.getRunMode();
+  int timesToRunInnerLoop = 1;
+  if(params_.getRunForReverseRelations())
+    timesToRunInnerLoop = 2;
+
+  for(int iter=0; iter<timesToRunInnerLoop; iter++) {
+    int modifiedRelationId = relationId + iter * numrelations;
+    ScopedProfile scopedProfile(profiles_.size() > 0 ? profiles_[modifiedRelationId].get() : NULL);
+    ScopedTimer timer(Profile::TOTAL);
+      
+    if(runMode != 1) { // if runMode==1 then read rules from file and write statistics
+      if(runMode == 0) { // if runMode>0, then read rules and so cannot clear
+	rules_[modifiedRelationId].clear();
+	ruleCache_.clearRelation(modifiedRelationId);
+      }
+      rulesadded_[modifiedRelationId].clear();
+      rulesselected_[modifiedRelationId].clear();
+      rulesweights_[modifiedRelationId].clear();
+
+      data_.createQueryFromTrainingData(modifiedRelationId);
+
+      if(params_.getRunColumnGeneration())
+	runColumnGenerationOneRelation(modifiedRelationId);
+      else
+	runOneRelation(modifiedRelationId);
+    }
+
+    writeScoresToFile(modifiedRelationId, scoresFileName);
+
+    writeRulesToFile(modifiedRelationId, rulesFileName);
+
+  }
+}
+
+// Writes the profile of every relation that was run, in the order of
+// the relation ids, after the phases that are common to all of them
+void Solver::writeProfileToFile(string fname)
+{
+  int numrelations = data_.getNumberRelations();
+  vector<string>& relations = data_.getRelations();
+
+  ofstream outfile(fname.c_str());
+  outfile<<"{"<<endl;
+  outfile<<"  \"run\": {"<<endl;
+  runProfile_.writeJSON(outfile, "    ");
+  outfile<<"  },"<<endl;
+  outfile<<"  \"relations\": ["<<endl;
+  bool first = true;
+  for(int i=0; i<(int)profiles_.size(); i++) {
+    Profile& profile = *profiles_[i];
+    if(profile.getCalls(Profile::TOTAL) == 0)
+      continue; // the relation was not run
+    if(!first)
+      outfile<<","<<endl;
+    first = false;
+    int relationId = i % numrelations;
+    outfile<<"    {"<<endl;
+    outfile<<"      \"relation_id\": "<<relationId<<","<<endl;
+    outfile<<"      \"relation\": \""<<escapeJSON(relations[relationId])<<"\","<<endl;
+    outfile<<"      \"reverse\": "<<(i >= numrelations ? "true" : "false")<<","<<endl;
+    profile.writeJSON(outfile, "      ");
+    outfile<<"    }";
+  }
+  outfile<<endl<<"  ]"<<endl;
+  outfile<<"}"<<endl;
+  outfile.close();
+  cout<<"Profile written to "<<fname<<endl;
+}
+
 void Solver::runOneRelation(int relationId)
 {
+  ScopedTrace trace("runOneRelation", relationId);
   int modelNumber = params_.getModelNumber();
   double objPenalty = params_.getPenaltyOnComplexity();
   bool addPenaltyOnNegativePairs = params_.getAddPenaltyOnNegativePairs();
@@ -174,6 +290,7 @@ void Solver::runOneRelation(int relationId)
   }
   else if(modelNumber == 2 || modelNumber == 3) {
     Model2MasterLP mlp = Model2MasterLP(relationId, data_);
+    mlp.setThreadBudget(&threadBudget_, params_.getLargeLPMinColumns(), params_.getLargeLPAlgorithm());
 
     int runMode = params_.getRunMode();
     if(runMode==0 || runMode==3) {
@@ -190,21 +307,14 @@ void Solver::runOneRelation(int relationId)
 
     assert(rules_[relationId].size() > 0);
     mlp.setMinPercentCoverage(minPercentCoverage_);
+    ScopedTimer columnTimer(Profile::COLUMN_BUILDING);
     if(modelNumber == 2) {
       if(addPenaltyOnNegativePairs) {
-	vector<int> column(data_.getNumPairsQuery(relationId));
-	for(int i=0; i<(int)rules_[relationId].size(); i++) {
-	  int numPairsExtraCov = getNumPairsExtraCoverage(relationId, rules_[relationId][i], column);
-	  bool coladded = mlp.addCol(rules_[relationId][i], column, objPenalty);
-	  if(coladded) {
-	    mlp.addNumPairsExtraCoverage(numPairsExtraCov);
-	    rulesadded_[relationId].push_back(i);
-	  }
-	}
+	addRuleColumnsWithExtraCoverage(relationId, mlp, objPenalty);
       }
       else {
 	for(int i=0; i<(int)rules_[relationId].size(); i++) {
-	  bool coladded = mlp.addCol(rules_[relationId][i], objPenalty);
+	  bool coladded = addRuleColumn(mlp, relationId, rules_[relationId][i], NULL, objPenalty);
 	  if(coladded) {
 	    rulesadded_[relationId].push_back(i);
 	  }
@@ -221,6 +331,7 @@ void Solver::runOneRelation(int relationId)
 	}
       }
     }
+    columnTimer.stop();
     cout<<"rules generated: "<<rules_[relationId].size()<<", rules added: "<<rulesadded_[relationId].size()<<", pairs in query: "<<data_.getNumPairsQuery(relationId)<<endl;
     mlp.printLPStatistics();
     mlp.setMaxComplexity(maxComplexity_[relationId]);
@@ -270,6 +381,7 @@ void Solver::setBestSettingsModel2(int relationId, Model2MasterLP& mlp)
 
 void Solver::runColumnGenerationOneRelation(int relationId)
 {
+  ScopedTrace trace("runColumnGenerationOneRelation", relationId);
   int modelNumber = params_.getModelNumber();
   double objPenalty = params_.getPenaltyOnComplexity();
   bool addPenaltyOnNegativePairs = params_.getAddPenaltyOnNegativePairs();
@@ -292,6 +404,7 @@ void Solver::runColumnGenerationOneRelation(int relationId)
   cout<<"Column Generation. Iteration 1"<<endl;
 
   Model2MasterLP mlp = Model2MasterLP(relationId, data_);
+  mlp.setThreadBudget(&threadBudget_, params_.getLargeLPMinColumns(), params_.getLargeLPAlgorithm());
 
   int runMode = params_.getRunMode();
   if(runMode==0 || runMode==3) {
@@ -306,26 +419,20 @@ void Solver::runColumnGenerationOneRelation(int relationId)
 
   assert(rules_[relationId].size() > 0);
   mlp.setMinPercentCoverage(minPercentCoverage_);
+  ScopedTimer columnTimer(Profile::COLUMN_BUILDING);
   if(addPenaltyOnNegativePairs) {
-    vector<int> column(data_.getNumPairsQuery(relationId));
-    for(int i=0; i<(int)rules_[relationId].size(); i++) {
-      int numPairsExtraCov = getNumPairsExtraCoverage(relationId, rules_[relationId][i], column);
-      bool coladded = mlp.addCol(rules_[relationId][i], column, objPenalty);
-      if(coladded) {
-	mlp.addNumPairsExtraCoverage(numPairsExtraCov);
-	rulesadded_[relationId].push_back(i);
-      }
-    }
+    addRuleColumnsWithExtraCoverage(relationId, mlp, objPenalty);
     mlp.setObjPenaltyOnNumPairsExtraCoverage(objPenaltyNegPairs[0]);
   }
   else {
     for(int i=0; i<(int)rules_[relationId].size(); i++) {
-      bool coladded = mlp.addCol(rules_[relationId][i], objPenalty);
+      bool coladded = addRuleColumn(mlp, relationId, rules_[relationId][i], NULL, objPenalty);
       if(coladded) {
 	rulesadded_[relationId].push_back(i);
       }
     }
   }
+  columnTimer.stop();
   cout<<"rules generated: "<<rules_[relationId].size()<<", rules added: "<<rulesadded_[relationId].size()<<", pairs in query: "<<data_.getNumPairsQuery(relationId)<<endl;
 
   mlp.printLPStatistics();
@@ -334,11 +441,23 @@ void Solver::runColumnGenerationOneRelation(int relationId)
   mlp.getSolution(rulesselected_[relationId], rulesweights_[relationId]);
   printSolution(relationId);
 
-  vector<double> duals_con11(data_.getNumPairsQuery(relationId));
+  int n_pairs = data_.getNumPairsQuery(relationId);
+  vector<double> duals_con11(n_pairs);
+  vector<double> dualsPricing(n_pairs);
+  vector<double> dualsCenter; // stability center for the dual smoothing
+  double centerBound = 0.0; // Lagrangian bound of the LP duals of the center
+  double alpha = params_.getDualSmoothingAlpha();
+  double objValue = mlp.getObjValue();
+  double bestBound = 0.0; // the objective function is non-negative
+  double gap = getRelativeGap(objValue, bestBound);
+  double gapTolerance = params_.getColumnGenerationGapTolerance();
+  int numIters = 1;
+  cout<<"CG convergence: iteration 1, LP objective: "<<objValue<<endl;
   int maxIter = params_.getMaxItersColumnGeneration() - 1;
   int maxRuleLength = params_.getMaxRuleLength();
   for(int iter=0; iter<maxIter; iter++) {
     cout<<"Column Generation. Iteration "<<iter+2<<endl;
+    numIters++;
     rulesselected_[relationId].clear();
     rulesweights_[relationId].clear();
 
@@ -347,46 +466,113 @@ void Solver::runColumnGenerationOneRelation(int relationId)
     int numRules = (int)rules_[relationId].size();
     int numRulesAdded = (int)rulesadded_[relationId].size();
 
-    generateRulesS0Duals(relationId, rules_[relationId], duals_con11, maxRuleLength);
-    assert(rules_[relationId].size() > 0);
-    mlp.setMinPercentCoverage(minPercentCoverage_);
-    if(addPenaltyOnNegativePairs) {
-      mlp.resetObjPenaltyOnNumPairsExtraCoverage();
-      vector<int> column(data_.getNumPairsQuery(relationId));
-      for(int i=numRules; i<(int)rules_[relationId].size(); i++) {
-	int numPairsExtraCov = getNumPairsExtraCoverage(relationId, rules_[relationId][i], column);
-	if(mlp.getReducedCost(rules_[relationId][i],column,duals_con11) >= 0.0) continue;
-	bool coladded = mlp.addCol(rules_[relationId][i], column, objPenalty);
-	if(coladded) {
-	  mlp.addNumPairsExtraCoverage(numPairsExtraCov);
-	  rulesadded_[relationId].push_back(i);
-	}
+    // Wentges smoothing: rules are generated with a convex combination
+    // of the stability center (the LP duals with the best Lagrangian
+    // bound so far) and the current LP duals, but are only added if
+    // they have a negative reduced cost with respect to the LP duals.
+    // If no rule is added (mispricing), price again with the LP duals.
+    bool smoothDuals = (alpha > 0.0 && dualsCenter.size() > 0);
+    bool misprice = false;
+    double bestReducedCost = 0.0;
+    double smoothing = (smoothDuals ? alpha : 0.0);
+    double dualsDistance = 0.0;
+    if(smoothDuals) {
+      for(int i=0; i<n_pairs; i++)
+	dualsDistance += fabs(duals_con11[i] - dualsCenter[i]);
+    }
+    while(true) {
+      int firstRule = (int)rules_[relationId].size();
+      for(int i=0; i<n_pairs; i++) {
+	if(smoothDuals)
+	  dualsPricing[i] = alpha * dualsCenter[i] + (1.0-alpha) * duals_con11[i];
+	else
+	  dualsPricing[i] = duals_con11[i];
       }
-      mlp.setObjPenaltyOnNumPairsExtraCoverage(objPenaltyNegPairs[0]); 
-    }
-    else {
-      for(int i=numRules; i<(int)rules_[relationId].size(); i++) {
-	vector<int> column;
-	if(mlp.getReducedCost(rules_[relationId][i],column,duals_con11) >= 0.0) continue;
-	bool coladded = mlp.addCol(rules_[relationId][i], column, objPenalty);
+      generateRulesS0Duals(relationId, rules_[relationId], dualsPricing, maxRuleLength);
+      assert(rules_[relationId].size() > 0);
+      mlp.setMinPercentCoverage(minPercentCoverage_);
+      vector<int> rulesToAdd;
+      vector<vector<int> > columns;
+      vector<vector<double> > countColumns; // with path_count_column
+      vector<int> numPairsExtraCov;
+      vector<double> reducedCosts;
+      priceNewRules(relationId, mlp, firstRule, duals_con11, rulesToAdd, columns, countColumns, numPairsExtraCov, reducedCosts);
+      // reduced cost of the pair (x,w) of each new column, including
+      // its objective coefficient and the cardinality constraint
+      for(int k=0; k<(int)rulesToAdd.size(); k++) {
+	int len = rules_[relationId][rulesToAdd[k]].getLengthRule();
+	double rc = objPenalty*(1+len) - (1+len)*dual_con7 + reducedCosts[k];
+	if(addPenaltyOnNegativePairs)
+	  rc += objPenaltyNegPairs[0]*numPairsExtraCov[k];
+	if(rc < bestReducedCost)
+	  bestReducedCost = rc;
+      }
+      ScopedTimer addTimer(Profile::COLUMN_BUILDING);
+      if(addPenaltyOnNegativePairs)
+	mlp.resetObjPenaltyOnNumPairsExtraCoverage();
+      for(int k=0; k<(int)rulesToAdd.size(); k++) {
+	int i = rulesToAdd[k];
+	vector<double>* countColumn = (countColumns.empty() ? NULL : &countColumns[k]);
+	bool coladded = addRuleColumn(mlp, relationId, rules_[relationId][i], &columns[k], objPenalty, countColumn);
 	if(coladded) {
+	  if(addPenaltyOnNegativePairs)
+	    mlp.addNumPairsExtraCoverage(numPairsExtraCov[k]);
 	  rulesadded_[relationId].push_back(i);
 	}
       }
-    }
-    cout<<"new rules generated: "<<rules_[relationId].size()-numRules<<", new rules added: "<<rulesadded_[relationId].size()-numRulesAdded<<", pairs in query: "<<data_.getNumPairsQuery(relationId)<<endl;
-    if(numRulesAdded == (int)rulesadded_[relationId].size()) {
+      if(addPenaltyOnNegativePairs)
+	mlp.setObjPenaltyOnNumPairsExtraCoverage(objPenaltyNegPairs[0]); 
+      addTimer.stop();
+      if(numRulesAdded < (int)rulesadded_[relationId].size() || !smoothDuals)
+	break;
+      cout<<"Mispricing with the smoothed duals. Pricing again with the LP duals"<<endl;
+      misprice = true;
+      smoothDuals = false;
+      smoothing = 0.0;
+    }
+
+    // Lagrangian bound: every column uses at least 2 units of the
+    // cardinality constraint, so at most cardinality/2 new columns
+    // can be at value 1 in any solution
+    double cardinality = factorToMultiplyComplexity*maxComplexity_[relationId];
+    double bound = objValue + (cardinality/2.0)*bestReducedCost;
+    if(bound > bestBound)
+      bestBound = bound;
+    // the reduced costs of the bound are those of the LP duals
+    if(alpha > 0.0 && (dualsCenter.size() == 0 || bound > centerBound)) {
+      dualsCenter = duals_con11;
+      centerBound = bound;
+    }
+    gap = getRelativeGap(objValue, bestBound);
+    cout<<"CG bound: iteration "<<iter+2<<", LP objective: "<<objValue<<", best reduced cost: "<<bestReducedCost<<", Lagrangian bound: "<<bound<<", best bound: "<<bestBound<<", gap: "<<gap<<endl;
+
+    int numNewRulesAdded = (int)rulesadded_[relationId].size()-numRulesAdded;
+    cout<<"new rules generated: "<<rules_[relationId].size()-numRules<<", new rules added: "<<numNewRulesAdded<<", pairs in query: "<<data_.getNumPairsQuery(relationId)<<endl;
+    if(numNewRulesAdded == 0) {
       cout<<"It didn't add any new rule. Quitting..."<<endl;
       break;
     }
+    // with the default tolerance 0 it stops as before, only when no
+    // rule is added
+    if(gapTolerance > 0.0 && gap <= gapTolerance) {
+      cout<<"Gap "<<gap<<" is below the tolerance "<<gapTolerance<<". Quitting..."<<endl;
+      break;
+    }
     mlp.printLPStatistics();
     int maxComplexity = maxComplexity_[relationId];
     mlp.setMaxComplexity(factorToMultiplyComplexity*maxComplexity);
     mlp.solveModel(params_.getWriteLpFile());
     mlp.getSolution(rulesselected_[relationId], rulesweights_[relationId]);
     printSolution(relationId);
+
+    double newObjValue = mlp.getObjValue();
+    cout<<"CG convergence: iteration "<<iter+2<<", LP objective: "<<newObjValue<<", improvement: "<<objValue-newObjValue<<", dual_con7: "<<dual_con7<<", smoothing: "<<smoothing<<", duals distance to center: "<<dualsDistance<<", mispricing: "<<misprice<<", columns added: "<<numNewRulesAdded<<endl;
+    objValue = newObjValue;
+    gap = getRelativeGap(objValue, bestBound);
   }
 
+  cout<<"Column generation certificate: iterations: "<<numIters<<", LP objective: "<<objValue<<", Lagrangian bound: "<<bestBound<<", gap: "<<gap<<endl;
+
   rulesselected_[relationId].clear();
   rulesweights_[relationId].clear();
 
@@ -397,6 +583,14 @@ void Solver::runColumnGenerationOneRelation(int relationId)
   printSolution(relationId, true);
 }
 
+double Solver::getRelativeGap(double objValue, double bound)
+{
+  double gap = objValue - bound;
+  if(gap <= 0.0)
+    return 0.0;
+  return gap / max(fabs(objValue), 1e-10);
+}
+
 void Solver::printSolution(int relationId, bool printAll)
 {
   int numRulesSelected = 0;
@@ -444,7 +638,8 @@ void Solver::printSolution(int relationId, bool printAll)
 
 int Solver::getNumPairsExtraCoverage(int modifiedRelationId, 
 				     Rule& rule,
-				     vector<int>& column)
+				     vector<int>& column,
+				     ExtraCoverageSummary* summary)
 {
   int numPairsExtraCov = 0;
   int numRelations = data_.getNumberRelations();
@@ -457,6 +652,56 @@ int Solver::getNumPairsExtraCoverage(int modifiedRelationId,
     exit(1);
   }
 
+  if(!getCoverageColumn(relationId, rule, column))
+    return numPairsExtraCov; // the column has only zeros
+
+  numPairsExtraCov = getNumPairsExtraCoverage(modifiedRelationId, rule, summary);
+  return numPairsExtraCov;
+}
+
+// Value of a pair with count paths of a rule in the path count columns,
+// and in the scores of the pairs when they are used
+static inline double pathCountFeature(int count)
+{
+  return count > 0 ? 1.0 + log((double)count) : 0.0;
+}
+
+// Adds the column of the rule to model 2: the 0/1 column of the query
+// pairs it covers (computed by the LP if column is NULL), or with
+// path_count_column the column of its number of paths (computed here
+// if countColumn is NULL, e.g. it is already known from the pricing)
+bool Solver::addRuleColumn(Model2MasterLP& mlp, int relationId, Rule& rule,
+			   vector<int>* column, double objPenalty,
+			   vector<double>* countColumn)
+{
+  if(params_.getPathCountColumn()) {
+    if(countColumn)
+      return mlp.addCol(rule, *countColumn, objPenalty);
+    vector<double> counts(data_.getNumPairsQuery(relationId));
+    getPathCountColumn(relationId, rule, counts);
+    return mlp.addCol(rule, counts, objPenalty);
+  }
+  if(column)
+    return mlp.addCol(rule, *column, objPenalty);
+  return mlp.addCol(rule, objPenalty);
+}
+
+// Column of the number of paths of the rule for each query pair,
+// counted up to path_count_max. A pair with n paths gets 1+ln(n), so
+// one path weighs as in the 0/1 column and many paths grow slowly.
+void Solver::getPathCountColumn(int relationId, Rule& rule, vector<double>& column)
+{
+  vector<int> counts;
+  data_.getPathCounts(relationId, rule, params_.getPathCountMax(), counts);
+  assert(counts.size() == column.size());
+  for(int i=0; i<(int)counts.size(); i++)
+    column[i] = pathCountFeature(counts[i]);
+}
+
+// Sets the column of the rule to 1 for the query pairs that it covers.
+// Returns false if it covers too few pairs for the column to be added.
+bool Solver::getCoverageColumn(int relationId, Rule& rule, vector<int>& column)
+{
   int n_pairs = data_.getNumPairsQuery(relationId);
   assert(n_pairs == column.size());
 
@@ -470,48 +715,422 @@ int Solver::getNumPairsExtraCoverage(int modifiedRelationId,
       column[i] = 0;
   }
 
-  if(nGreaterZero <= minPercentCoverage_*n_pairs)
-    return numPairsExtraCov; // the column has only zeros
+  return nGreaterZero > minPercentCoverage_*n_pairs;
+}
+
+int Solver::getNumPairsExtraCoverage(int modifiedRelationId, Rule& rule,
+				     ExtraCoverageSummary* summary)
+{
+  int numPairsExtraCov = 0;
+  int numRelations = data_.getNumberRelations();
+  int relationId = modifiedRelationId;
+  if(modifiedRelationId >= numRelations) {
+    cout<<"In getNumPairsExtraCoverage(...) isReverse is not implemented"<<endl;
+    exit(1);
+  }
+
+  if(params_.getNegKEstimator()) {
+    double halfWidth;
+    int numSampled, numAnchors;
+    double estimate = estimateNumPairsExtraCoverage(relationId, rule, halfWidth, numSampled, numAnchors);
+    if(summary)
+      summary->add(estimate, halfWidth, numSampled, numAnchors);
+    return (int)(estimate + 0.5);
+  }
 
   bool useBFS = params_.getUseBreadthFirstSearch();
-  map<int,set<int> > rEntities, lEntities;
-  getEntitiesOfInterest(relationId, 0, rEntities, lEntities);
+  int numRightKeys = knownFacts_.getNumKeys(relationId, KnownFacts::TRAIN, KnownFacts::RIGHT);
+  int numLeftKeys = knownFacts_.getNumKeys(relationId, KnownFacts::TRAIN, KnownFacts::LEFT);
+  vector<int> entities; // reached by the rule, sorted
 
   int largeInt = 10000000;
   bool speedUpComputationNegK = params_.getSpeedUpComputationNegK();
   // remove right entities
   int counter=0;
-  int maxCounter = 0.02*((int)rEntities.size());
+  int maxCounter = 0.02*numRightKeys;
   if(maxCounter<10) maxCounter=10;
-  for(map<int,set<int> >::iterator it=rEntities.begin(); it!=rEntities.end() && numPairsExtraCov<largeInt; it++) {
+  for(int k=0; k<numRightKeys && numPairsExtraCov<largeInt; k++) {
     counter++;
     if(speedUpComputationNegK && counter>=maxCounter) break;
-    int origId = it->first;
-    set<int> destIds;
-    data_.getRightEntities(rule, origId, destIds, useBFS);
-    set<int> diff;
-    set_difference(destIds.begin(), destIds.end(), rEntities[origId].begin(), rEntities[origId].end(), inserter(diff, diff.end()));
-    numPairsExtraCov += (int)(diff.size());
+    numPairsExtraCov += getNumPairsExtraCoverage(relationId, rule, KnownFacts::RIGHT, k, entities, useBFS);
   }
 
   // remove left entities
   counter=0;
-  maxCounter = 0.02*((int)rEntities.size());
+  maxCounter = 0.02*numRightKeys;
   if(maxCounter<10) maxCounter=10;
-  for(map<int,set<int> >::iterator it=lEntities.begin(); it!=lEntities.end() && numPairsExtraCov<largeInt; it++) {
+  for(int k=0; k<numLeftKeys && numPairsExtraCov<largeInt; k++) {
     counter++;
     if(speedUpComputationNegK && counter>=maxCounter) break;
-    int destId = it->first;
-    set<int> origIds;
-    data_.getLeftEntities(rule, destId, origIds, useBFS);
-    set<int> diff;
-    set_difference(origIds.begin(), origIds.end(), lEntities[destId].begin(), lEntities[destId].end(), inserter(diff, diff.end()));
-    numPairsExtraCov += (int)(diff.size());
+    numPairsExtraCov += getNumPairsExtraCoverage(relationId, rule, KnownFacts::LEFT, k, entities, useBFS);
   }
 
   return numPairsExtraCov;
 }
 
+// Pairs of extra coverage of the rule from the k-th entity with
+// training pairs on the given side
+int Solver::getNumPairsExtraCoverage(int relationId, Rule& rule, int side,
+				     int k, vector<int>& entities, bool useBFS)
+{
+  int entityId = knownFacts_.getKey(relationId, KnownFacts::TRAIN, side, k);
+  if(side == KnownFacts::RIGHT)
+    data_.getRightEntities(rule, entityId, entities, useBFS);
+  else
+    data_.getLeftEntities(rule, entityId, entities, useBFS);
+  const int* known;
+  const int* knownEnd;
+  knownFacts_.getEntitiesOfKey(relationId, KnownFacts::TRAIN, side, k, known, knownEnd);
+  return KnownFacts::countNotKnown(entities.data(), entities.data()+entities.size(), known, knownEnd);
+}
+
+// Pairs of extra coverage of the rules ruleIds of the relation, as in
+// getNumPairsExtraCoverage, with a single walk from each entity with
+// training pairs: the rules are put in a prefix tree for each side, so
+// the arcs of a common prefix are scanned once for all of them. The
+// entities are divided among numThreads threads. A count is limited to
+// 10000000 instead of stopping the loop over the entities there.
+void Solver::getNumPairsExtraCoverageBatch(int relationId, vector<int>& ruleIds,
+					   int numThreads,
+					   vector<int>& numPairsExtraCov)
+{
+  if(relationId >= data_.getNumberRelations()) {
+    cout<<"In getNumPairsExtraCoverageBatch(...) isReverse is not implemented"<<endl;
+    exit(1);
+  }
+
+  int numRules = (int)ruleIds.size();
+  numPairsExtraCov.assign(numRules, 0);
+  if(numRules == 0)
+    return;
+
+  Profile* profile = Profile::getCurrent();
+  bool speedUpComputationNegK = params_.getSpeedUpComputationNegK();
+  int numRightKeys = knownFacts_.getNumKeys(relationId, KnownFacts::TRAIN, KnownFacts::RIGHT);
+  int maxCounter = 0.02*numRightKeys;
+  if(maxCounter<10) maxCounter=10;
+
+  vector<long long> counts(numRules, 0);
+  for(int side=0; side<2; side++) {
+    RuleTrie trie(side == KnownFacts::LEFT);
+    for(int r=0; r<numRules; r++)
+      trie.addRule(rules_[relationId][ruleIds[r]]);
+    int numKeys = knownFacts_.getNumKeys(relationId, KnownFacts::TRAIN, side);
+    if(speedUpComputationNegK && numKeys > maxCounter-1)
+      numKeys = maxCounter-1;
+
+#pragma omp parallel num_threads(numThreads)
+    {
+      ScopedProfile scopedProfile(profile);
+      vector<vector<int> > entities(numRules);
+      vector<int> touchedRules;
+      vector<long long> localCounts(numRules, 0);
+#pragma omp for schedule(dynamic)
+      for(int k=0; k<numKeys; k++) {
+	int entityId = knownFacts_.getKey(relationId, KnownFacts::TRAIN, side, k);
+	data_.getEntitiesOfRules(trie, entityId, entities, touchedRules);
+	const int* known;
+	const int* knownEnd;
+	knownFacts_.getEntitiesOfKey(relationId, KnownFacts::TRAIN, side, k, known, knownEnd);
+	for(int i=0; i<(int)touchedRules.size(); i++) {
+	  vector<int>& ids = entities[touchedRules[i]];
+	  localCounts[touchedRules[i]] += KnownFacts::countNotKnown(ids.data(), ids.data()+ids.size(), known, knownEnd);
+	  ids.clear();
+	}
+      }
+#pragma omp critical
+      for(int r=0; r<numRules; r++)
+	counts[r] += localCounts[r];
+    }
+  }
+
+  int largeInt = 10000000;
+  for(int r=0; r<numRules; r++)
+    numPairsExtraCov[r] = counts[r] < largeInt ? (int)counts[r] : largeInt;
+}
+
+// Adds the columns of all the rules of the relation to model 2 with
+// their pairs of extra coverage. With batch_extra_coverage the coverage
+// columns are computed first, and the pairs of extra coverage only for
+// the rules with enough coverage to be added, in one batch with the
+// threads available in the budget.
+void Solver::addRuleColumnsWithExtraCoverage(int relationId, Model2MasterLP& mlp,
+					     double objPenalty)
+{
+  bool batchExtraCoverage = params_.getBatchExtraCoverage() && !params_.getNegKEstimator();
+  int numRules = (int)rules_[relationId].size();
+  vector<int> column(data_.getNumPairsQuery(relationId));
+  if(!batchExtraCoverage) {
+    ExtraCoverageSummary summary;
+    for(int i=0; i<numRules; i++) {
+      int numPairsExtraCov = getNumPairsExtraCoverage(relationId, rules_[relationId][i], column, &summary);
+      bool coladded = addRuleColumn(mlp, relationId, rules_[relationId][i], &column, objPenalty);
+      if(coladded) {
+	mlp.addNumPairsExtraCoverage(numPairsExtraCov);
+	rulesadded_[relationId].push_back(i);
+      }
+    }
+    summary.print(relationId);
+    return;
+  }
+
+  vector<int> batchRuleIds, batchExtraCov;
+  vector<vector<int> > columns;
+  for(int i=0; i<numRules; i++) {
+    if(!getCoverageColumn(relationId, rules_[relationId][i], column))
+      continue; // the column will not be added
+    batchRuleIds.push_back(i);
+    columns.push_back(column);
+  }
+  int extraThreads = threadBudget_.acquire(params_.getNumberThreads()-1);
+  getNumPairsExtraCoverageBatch(relationId, batchRuleIds, 1+extraThreads, batchExtraCov);
+  threadBudget_.release(extraThreads);
+  for(int b=0; b<(int)batchRuleIds.size(); b++) {
+    int i = batchRuleIds[b];
+    bool coladded = addRuleColumn(mlp, relationId, rules_[relationId][i], &columns[b], objPenalty);
+    if(coladded) {
+      mlp.addNumPairsExtraCoverage(batchExtraCov[b]);
+      rulesadded_[relationId].push_back(i);
+    }
+  }
+}
+
+// Order in which the estimate of the pairs of extra coverage draws the
+// entities of each side of each relation: a Fisher-Yates shuffle of
+// its keys that only depends on the relation. It is computed once,
+// since every rule of the relation uses it.
+void Solver::buildSampleOrders()
+{
+  int numRelations = data_.getNumberRelations();
+  sampleOrders_.assign(2*numRelations, vector<int>());
+  for(int relationId=0; relationId<numRelations; relationId++) {
+    for(int side=0; side<2; side++) {
+      vector<int>& order = sampleOrders_[2*relationId+side];
+      int numKeys = knownFacts_.getNumKeys(relationId, KnownFacts::TRAIN, side);
+      order.resize(numKeys);
+      for(int k=0; k<numKeys; k++)
+	order[k] = k;
+      for(int i=0; i<numKeys; i++) {
+	int j = i + rng_.uniformInt(numKeys-i, CounterRNG::EXTRA_COVERAGE_SAMPLE, relationId, side, i);
+	swap(order[i], order[j]);
+      }
+    }
+  }
+}
+
+// Estimates the pairs of extra coverage of the rule from a sample of
+// the entities with training pairs, drawn uniformly and without
+// replacement on each side. The sides are the strata of the estimate:
+// each contributes its number of entities times the mean of its sample,
+// and the variance includes the finite population correction. The
+// sample of both sides doubles until the half width of the 95%
+// confidence interval is within neg_k_relative_error of the estimate,
+// or all the entities are sampled. A sample of zeros is accepted once
+// it bounds the fraction of entities with extra coverage by
+// neg_k_relative_error. The order in which the entities are drawn only
+// depends on the relation (see buildSampleOrders), so every rule of a
+// relation is evaluated on the same entities and the estimates are
+// reproducible.
+double Solver::estimateNumPairsExtraCoverage(int relationId, Rule& rule,
+					     double& halfWidth,
+					     int& numSampled, int& numAnchors)
+{
+  bool useBFS = params_.getUseBreadthFirstSearch();
+  double relativeError = params_.getNegKRelativeError();
+  double largeInt = 10000000;
+  vector<int> entities; // reached by the rule, sorted
+
+  assert((int)sampleOrders_.size() == 2*data_.getNumberRelations());
+  int numKeys[2];
+  vector<int>* order[2];
+  vector<int> values[2];
+  for(int side=0; side<2; side++) {
+    numKeys[side] = knownFacts_.getNumKeys(relationId, KnownFacts::TRAIN, side);
+    order[side] = &sampleOrders_[2*relationId+side];
+  }
+  numAnchors = numKeys[0] + numKeys[1];
+
+  double estimate = 0.0;
+  int sampleSize = params_.getNegKMinSample();
+  while(true) {
+    double variance = 0.0;
+    bool isComplete = true;
+    bool onlyZeros = true; // in the sides that are not complete
+    estimate = 0.0;
+    for(int side=0; side<2; side++) {
+      int n = sampleSize < numKeys[side] ? sampleSize : numKeys[side];
+      for(int i=(int)values[side].size(); i<n; i++)
+	values[side].push_back(getNumPairsExtraCoverage(relationId, rule, side, (*order[side])[i], entities, useBFS));
+      if(n == 0)
+	continue;
+      double sum = 0.0, sumSquares = 0.0;
+      for(int i=0; i<n; i++) {
+	sum += values[side][i];
+	sumSquares += (double)values[side][i]*values[side][i];
+      }
+      double mean = sum/n;
+      double N = numKeys[side];
+      estimate += N*mean;
+      if(n < numKeys[side]) {
+	isComplete = false;
+	if(sum > 0.0)
+	  onlyZeros = false;
+	double s2 = (sumSquares - n*mean*mean)/(n-1);
+	if(s2 > 0.0)
+	  variance += N*N*(1.0-n/N)*s2/n;
+      }
+    }
+    halfWidth = 1.96*sqrt(variance);
+    if(isComplete || estimate >= largeInt)
+      break;
+    if(estimate > 0.0 && halfWidth <= relativeError*estimate)
+      break;
+    // a sample of zeros has no variance; by the rule of three, less than
+    // 3/n of the entities have extra coverage with 95% confidence
+    if(onlyZeros && 3.0 <= relativeError*sampleSize)
+      break;
+    sampleSize *= 2;
+  }
+
+  numSampled = (int)(values[0].size() + values[1].size());
+  return estimate;
+}
+
+void ExtraCoverageSummary::add(double estimate, double halfWidth,
+			       int numSampled, int numAnchors)
+{
+  lock_guard<mutex> lock(mutex_);
+  numRules_++;
+  numSampled_ += numSampled;
+  numAnchors_ += numAnchors;
+  double relativeHalfWidth = estimate > 0.0 ? halfWidth/estimate : 0.0;
+  sumRelativeHalfWidth_ += relativeHalfWidth;
+  if(relativeHalfWidth > maxRelativeHalfWidth_)
+    maxRelativeHalfWidth_ = relativeHalfWidth;
+}
+
+void ExtraCoverageSummary::print(int relationId)
+{
+  if(numRules_ == 0)
+    return;
+  cout<<"Extra coverage estimated for relation "<<relationId<<": rules: "<<numRules_
+      <<", entities sampled: "<<100.0*numSampled_/numAnchors_<<"%"
+      <<", mean relative half width of the 95% interval: "<<sumRelativeHalfWidth_/numRules_
+      <<", max: "<<maxRelativeHalfWidth_<<endl;
+}
+
+void Solver::priceNewRules(int relationId, Model2MasterLP& mlp,
+			   int firstRule, vector<double>& duals_con11,
+			   vector<int>& rulesToAdd,
+			   vector<vector<int> >& columns,
+			   vector<vector<double> >& countColumns,
+			   vector<int>& numPairsExtraCov,
+			   vector<double>& reducedCosts)
+{
+  // Rules firstRule, firstRule+1, ... of rules_[relationId] are
+  // the candidates. The reduced cost only needs the coverage column,
+  // so it is computed first and the candidates with a non-negative
+  // reduced cost are discarded. The number of pairs of extra coverage,
+  // which is much more expensive, is only computed for the survivors,
+  // one at a time or all of them in one batch (batch_extra_coverage).
+  // With path_count_column the candidates are priced with the column
+  // of path counts that addRuleColumn adds to the LP, which is returned
+  // in countColumns, and the coverage column is the set of pairs with
+  // some path.
+  ScopedTimer timer(Profile::PRICING);
+  Profile* profile = Profile::getCurrent();
+  bool addPenaltyOnNegativePairs = params_.getAddPenaltyOnNegativePairs();
+  bool pathCountColumn = params_.getPathCountColumn();
+  bool batchExtraCoverage = params_.getBatchExtraCoverage() && !params_.getNegKEstimator();
+  int extraThreads = threadBudget_.acquire(params_.getNumberThreads()-1);
+  int numThreads = 1 + extraThreads;
+  int n_pairs = data_.getNumPairsQuery(relationId);
+  int numCandidates = (int)rules_[relationId].size() - firstRule;
+
+  vector<vector<int> > candColumns(numCandidates);
+  vector<vector<double> > candCountColumns(pathCountColumn ? numCandidates : 0);
+  vector<double> candReducedCosts(numCandidates);
+#pragma omp parallel num_threads(numThreads)
+  {
+    ScopedProfile scopedProfile(profile);
+#pragma omp for schedule(dynamic)
+    for(int k=0; k<numCandidates; k++) {
+      Rule& rule = rules_[relationId][firstRule+k];
+      if(pathCountColumn) {
+	vector<double>& countColumn = candCountColumns[k];
+	countColumn.resize(n_pairs);
+	getPathCountColumn(relationId, rule, countColumn);
+	candColumns[k].resize(n_pairs);
+	for(int i=0; i<n_pairs; i++)
+	  candColumns[k][i] = (countColumn[i] > 0.0 ? 1 : 0);
+	candReducedCosts[k] = mlp.getReducedCost(countColumn, duals_con11);
+      }
+      else
+	candReducedCosts[k] = mlp.getReducedCost(rule, candColumns[k], duals_con11);
+    }
+  }
+
+  rulesToAdd.clear();
+  columns.clear();
+  countColumns.clear();
+  reducedCosts.clear();
+  for(int k=0; k<numCandidates; k++) {
+    if(candReducedCosts[k] >= 0.0) continue;
+    rulesToAdd.push_back(firstRule+k);
+    columns.push_back(vector<int>());
+    columns.back().swap(candColumns[k]);
+    if(pathCountColumn) {
+      countColumns.push_back(vector<double>());
+      countColumns.back().swap(candCountColumns[k]);
+    }
+    reducedCosts.push_back(candReducedCosts[k]);
+  }
+
+  int numSurvivors = (int)rulesToAdd.size();
+  numPairsExtraCov.assign(numSurvivors, 0);
+  ExtraCoverageSummary summary;
+  if(addPenaltyOnNegativePairs && batchExtraCoverage) {
+    // the survivors whose column will be added, in one batch
+    vector<int> batch, batchRuleIds, batchExtraCov;
+    for(int k=0; k<numSurvivors; k++) {
+      int nGreaterZero = 0;
+      for(int i=0; i<n_pairs; i++) {
+	if(columns[k][i] > 0)
+	  nGreaterZero++;
+      }
+      if(nGreaterZero <= minPercentCoverage_*n_pairs)
+	continue; // the column will not be added
+      batch.push_back(k);
+      batchRuleIds.push_back(rulesToAdd[k]);
+    }
+    getNumPairsExtraCoverageBatch(relationId, batchRuleIds, numThreads, batchExtraCov);
+    for(int b=0; b<(int)batch.size(); b++)
+      numPairsExtraCov[batch[b]] = batchExtraCov[b];
+  }
+  else if(addPenaltyOnNegativePairs) {
+#pragma omp parallel num_threads(numThreads)
+    {
+      ScopedProfile scopedProfile(profile);
+#pragma omp for schedule(dynamic)
+      for(int k=0; k<numSurvivors; k++) {
+	int nGreaterZero = 0;
+	for(int i=0; i<n_pairs; i++) {
+	  if(columns[k][i] > 0)
+	    nGreaterZero++;
+	}
+	if(nGreaterZero <= minPercentCoverage_*n_pairs)
+	  continue; // the column will not be added
+	numPairsExtraCov[k] = getNumPairsExtraCoverage(relationId, rules_[relationId][rulesToAdd[k]], &summary);
+      }
+    }
+    summary.print(relationId);
+  }
+
+  threadBudget_.release(extraThreads);
+
+  cout<<"candidates priced: "<<numCandidates<<", with negative reduced cost: "<<numSurvivors<<", threads: "<<numThreads<<endl;
+}
+
 void Solver::getColumnForRule(int modifiedRelationId, Rule& rule,
 			      vector<double>& column)
 {
@@ -550,9 +1169,10 @@ void Solver::getColumnForRule(int modifiedRelationId, Rule& rule,
 
   bool useBFS = params_.getUseBreadthFirstSearch();
   double alpha = params_.getAlphaConvexCombinationModel3();
-  vector<double> scores((int)entities.size());
-  vector<bool> useRightEntity((int)entities.size());
-  vector<bool> useLeftEntity((int)entities.size());
+  vector<double> scores((int)entities.size(), 0.0);
+  vector<int> touched;
+  vector<int> filteredRight, filteredLeft;
+  RankStatistics stats((int)entities.size());
   for(int i=0; i<n_pairs; i++) {
     pair<int,int>& tempcpair = entpairs[i];
     pair<int,int> cpair;
@@ -561,45 +1181,39 @@ void Solver::getColumnForRule(int modifiedRelationId, Rule& rule,
       continue;
     if(isReverse) {
       cpair = pair<int,int>(tempcpair.second, tempcpair.first);
-      getEntitiesOfInterestForTail(relationId, cpair.first, useRightEntity, false);
-      getEntitiesOfInterestForHead(relationId, cpair.second, useLeftEntity, false);
+      getFilteredEntitiesForTail(relationId, cpair.first, filteredRight, false);
+      getFilteredEntitiesForHead(relationId, cpair.second, filteredLeft, false);
     }
     else {
       cpair = pair<int,int>(tempcpair.first, tempcpair.second);
-      getEntitiesOfInterestForHead(relationId, cpair.first, useRightEntity, false);
-      getEntitiesOfInterestForTail(relationId, cpair.second, useLeftEntity, false);
+      getFilteredEntitiesForHead(relationId, cpair.first, filteredRight, false);
+      getFilteredEntitiesForTail(relationId, cpair.second, filteredLeft, false);
     }
     int rankRightFiltered = 1;
     int rankLeftFiltered = 1;
 
     { // remove right entities
       int origId = cpair.first;
-      getRightScores(outArcsWithRelation[i], rule, origId, scores, useBFS);
+      data_.getRightEntities(outArcsWithRelation[i], rule, origId, touched, useBFS);
+      for(int t=0; t<(int)touched.size(); t++)
+	scores[touched[t]] = 1.0;
       assert(basescore == scores[cpair.second]);
-      for(int k=0; k<(int)entities.size(); k++) {
-	if(k != cpair.first && k != cpair.second) {
-	  double score = scores[k];
-	  if(shouldUpdateRanking(basescore, score, rankingType)) {
-	    if(useRightEntity[k])
-	      rankRightFiltered++;
-	  }
-	}
-      }
+      stats.compute(basescore, scores, touched, cpair.first, cpair.second, filteredRight);
+      rankRightFiltered = stats.getRank(rankingType, true);
+      for(int t=0; t<(int)touched.size(); t++)
+	scores[touched[t]] = 0.0;
     }
 
     { // remove left entities
       int destId = cpair.second;
-      getLeftScores(outArcsWithRelation[i], rule, destId, scores, useBFS);
+      data_.getLeftEntities(outArcsWithRelation[i], rule, destId, touched, useBFS);
+      for(int t=0; t<(int)touched.size(); t++)
+	scores[touched[t]] = 1.0;
       assert(basescore == scores[cpair.first]);
-      for(int k=0; k<(int)entities.size(); k++) {
-	if(k != cpair.first && k != cpair.second) {
-	  double score = scores[k];
-	  if(shouldUpdateRanking(basescore, score, rankingType)) {
-	    if(useLeftEntity[k])
-	      rankLeftFiltered++;
-	  }
-	}
-      }
+      stats.compute(basescore, scores, touched, cpair.first, cpair.second, filteredLeft);
+      rankLeftFiltered = stats.getRank(rankingType, true);
+      for(int t=0; t<(int)touched.size(); t++)
+	scores[touched[t]] = 0.0;
     }
 
     double mrr = (1.0/rankRightFiltered+1.0/rankLeftFiltered)/2;
@@ -621,13 +1235,23 @@ double Solver::getScore(int relationId, Rule& rule, int cpairId)
   return score;
 }
 
+// Sum of the weights of the selected rules with a path for the pair,
+// or with path_count_column of their weights by the value of the
+// number of paths, as in the columns of model 2
 double Solver::getScore(int relationId, pair<int,int>& cpair)
 {
+  bool pathCountColumn = params_.getPathCountColumn();
+  int pathCountMax = params_.getPathCountMax();
   double score = 0.0;
   for(int j=0; j<(int)rulesselected_[relationId].size(); j++) {
     if(rulesselected_[relationId][j] > 0) {
       Rule& rule = rules_[relationId][rulesadded_[relationId][j]];
-      if(data_.hasPath(rule, cpair))
+      if(pathCountColumn) {
+	int count = data_.countPaths(rule, cpair, pathCountMax);
+	if(count > 0)
+	  score += rulesweights_[relationId][j]*pathCountFeature(count);
+      }
+      else if(data_.hasPath(rule, cpair))
 	score += rulesweights_[relationId][j];
     }
   }
@@ -635,92 +1259,15 @@ double Solver::getScore(int relationId, pair<int,int>& cpair)
   return score;
 }
 
-void Solver::getEntitiesOfInterest(int relationId, int whichCombination, map<int,set<int> >& rEntities, map<int,set<int> >& lEntities)
-{
-  // whichCombination = 0 => do train
-  // whichCombination = 1 => do train + valid
-  // whichCombination = 2 => do train + valid + test
-  assert(0 <= whichCombination && whichCombination <= 2);
-
-  // entities from test dataset
-  if(whichCombination >= 2) {
-    TestData& testdata = data_.getTestData();
-    int n_pairs = testdata.getNumEntityPairs(relationId);
-    vector<pair<int,int> >& entpairs = testdata.getEntityPairs(relationId);
-    for(int i=0; i<n_pairs; i++) {
-      pair<int,int>& cpair = entpairs[i];
-      rEntities[cpair.first].insert(cpair.second);
-      lEntities[cpair.second].insert(cpair.first);
-    }
-  }
-
-  // entities from valid dataset
-  if(whichCombination >= 1) {
-    TestData& validdata = data_.getValidData();
-    int n_pairs = validdata.getNumEntityPairs(relationId);
-    vector<pair<int,int> >& entpairs = validdata.getEntityPairs(relationId);
-    for(int i=0; i<n_pairs; i++) {
-      pair<int,int>& cpair = entpairs[i];
-      rEntities[cpair.first].insert(cpair.second);
-      lEntities[cpair.second].insert(cpair.first);
-    }
-  }
-
-  // entities from train dataset
-  vector<Arc*>& arcs = data_.getArcs();
-  for(int i=0; i<(int)arcs.size(); i++) {
-    Arc* arc = arcs[i];
-    if(arc->getIdRelation() == relationId) {
-      int tailId = arc->getTail()->getId();
-      int headId = arc->getHead()->getId();
-      rEntities[tailId].insert(headId);
-      lEntities[headId].insert(tailId);
-    }
-  }
-
-}
-
 void Solver::getEntitiesOfInterestForHead(int relationId, int tail, vector<bool>& useEntity, bool useAllData)
 {
   int numEntities = (int)useEntity.size();
   for(int i=0; i<numEntities; i++)
     useEntity[i] = true;
-  useEntity[tail] = false; // do not use the tail as head
-
-  // entities from test dataset
-  if(useAllData)
-  {
-    TestData& testdata = data_.getTestData();
-    int n_pairs = testdata.getNumEntityPairs(relationId);
-    vector<pair<int,int> >& entpairs = testdata.getEntityPairs(relationId);
-    for(int i=0; i<n_pairs; i++) {
-      pair<int,int>& cpair = entpairs[i];
-      if(cpair.first == tail)
-	useEntity[cpair.second] = false;
-    }
-  }
-
-  // entities from valid dataset
-  {
-    TestData& validdata = data_.getValidData();
-    int n_pairs = validdata.getNumEntityPairs(relationId);
-    vector<pair<int,int> >& entpairs = validdata.getEntityPairs(relationId);
-    for(int i=0; i<n_pairs; i++) {
-      pair<int,int>& cpair = entpairs[i];
-      if(cpair.first == tail)
-	useEntity[cpair.second] = false;
-    }
-  }
-
-  // entities from train dataset
-  vector<vector<Arc*> >& allarcs = data_.getOutArcs();
-  vector<Arc*>& arcs = allarcs[tail];
-  for(int i=0; i<(int)arcs.size(); i++) {
-    Arc* arc = arcs[i];
-    if(arc->getIdRelation() == relationId)
-      useEntity[arc->getHead()->getId()] = false;
-  }
-
+  vector<int> filtered;
+  getFilteredEntitiesForHead(relationId, tail, filtered, useAllData);
+  for(int i=0; i<(int)filtered.size(); i++)
+    useEntity[filtered[i]] = false;
 }
 
 void Solver::getEntitiesOfInterestForTail(int relationId, int head, vector<bool>& useEntity, bool useAllData)
@@ -728,45 +1275,109 @@ void Solver::getEntitiesOfInterestForTail(int relationId, int head, vector<bool>
   int numEntities = (int)useEntity.size();
   for(int i=0; i<numEntities; i++)
     useEntity[i] = true;
-  useEntity[head] = false; // do not use the head as tail
+  vector<int> filtered;
+  getFilteredEntitiesForTail(relationId, head, filtered, useAllData);
+  for(int i=0; i<(int)filtered.size(); i++)
+    useEntity[filtered[i]] = false;
+}
 
-  // entities from test dataset
-  if(useAllData)
-  {
-    TestData& testdata = data_.getTestData();
-    int n_pairs = testdata.getNumEntityPairs(relationId);
-    vector<pair<int,int> >& entpairs = testdata.getEntityPairs(relationId);
-    for(int i=0; i<n_pairs; i++) {
-      pair<int,int>& cpair = entpairs[i];
-      if(cpair.second == head)
-	useEntity[cpair.first] = false;
-    }
-  }
+// Entities left out of the filtered ranking of the heads for the given
+// tail: the tail and the heads of its pairs in train and valid, and in
+// test if useAllData
+void Solver::getFilteredEntitiesForHead(int relationId, int tail, vector<int>& filtered, bool useAllData)
+{
+  int combination = useAllData ? KnownFacts::TRAIN_VALID_TEST : KnownFacts::TRAIN_VALID;
+  const int* first;
+  const int* last;
+  knownFacts_.getEntities(relationId, combination, KnownFacts::RIGHT, tail, first, last);
+  filtered.clear();
+  filtered.push_back(tail); // do not use the tail as head
+  filtered.insert(filtered.end(), first, last);
+}
 
-  // entities from valid dataset
-  {
-    TestData& validdata = data_.getValidData();
-    int n_pairs = validdata.getNumEntityPairs(relationId);
-    vector<pair<int,int> >& entpairs = validdata.getEntityPairs(relationId);
-    for(int i=0; i<n_pairs; i++) {
-      pair<int,int>& cpair = entpairs[i];
-      if(cpair.second == head)
-	useEntity[cpair.first] = false;
-    }
-  }
+// Entities left out of the filtered ranking of the tails for the given
+// head: the head and the tails of its pairs in train and valid, and in
+// test if useAllData
+void Solver::getFilteredEntitiesForTail(int relationId, int head, vector<int>& filtered, bool useAllData)
+{
+  int combination = useAllData ? KnownFacts::TRAIN_VALID_TEST : KnownFacts::TRAIN_VALID;
+  const int* first;
+  const int* last;
+  knownFacts_.getEntities(relationId, combination, KnownFacts::LEFT, head, first, last);
+  filtered.clear();
+  filtered.push_back(head); // do not use the head as tail
+  filtered.insert(filtered.end(), first, last);
+}
 
-  // entities from train dataset
-  vector<vector<Arc*> >& allarcs = data_.getInArcs();
-  vector<Arc*>& arcs = allarcs[head];
-  for(int i=0; i<(int)arcs.size(); i++) {
-    Arc* arc = arcs[i];
-    if(arc->getIdRelation() == relationId)
-      useEntity[arc->getTail()->getId()] = false;
-  }
+// Raw and filtered ranks of the target for a ranking type. The random
+// break puts each entity tied with the target above it with
+// probability 1/2, drawn with a key made of the stream, the relation,
+// the pair, the side and the entity, and an entity tied in both
+// rankings is drawn once. The untouched entities tied at zero are keyed
+// by numEntities plus their position among them.
+void Solver::getRanks(RankStatistics& stats, int rankingType, uint32_t stream,
+		      int modifiedRelationId, int pairIndex, int side,
+		      int& rankRaw, int& rankFiltered)
+{
+  if(rankingType != 3) {
+    rankRaw = stats.getRank(rankingType, false);
+    rankFiltered = stats.getRank(rankingType, true);
+    return;
+  }
+
+  uint32_t pairSide = 2*(uint32_t)pairIndex + side;
+  int numEntities = (int)data_.getEntities().size();
+  int aboveFiltered = 0;
+  int aboveOnlyRaw = 0;
+  vector<int>& tiedFiltered = stats.getTiedEntities(true);
+  for(int t=0; t<(int)tiedFiltered.size(); t++)
+    if(rng_.coinFlip(stream, modifiedRelationId, pairSide, tiedFiltered[t]))
+      aboveFiltered++;
+  vector<int>& tiedOnlyRaw = stats.getTiedEntities(false);
+  for(int t=0; t<(int)tiedOnlyRaw.size(); t++)
+    if(rng_.coinFlip(stream, modifiedRelationId, pairSide, tiedOnlyRaw[t]))
+      aboveOnlyRaw++;
+  int numZeroTiesFiltered = stats.getNumZeroTies(true);
+  int numZeroTiesOnlyRaw = stats.getNumZeroTies(false);
+  for(int t=0; t<numZeroTiesFiltered; t++)
+    if(rng_.coinFlip(stream, modifiedRelationId, pairSide, numEntities+t))
+      aboveFiltered++;
+  for(int t=numZeroTiesFiltered; t<numZeroTiesFiltered+numZeroTiesOnlyRaw; t++)
+    if(rng_.coinFlip(stream, modifiedRelationId, pairSide, numEntities+t))
+      aboveOnlyRaw++;
+  rankRaw = 1 + stats.getNumGreater(false) + aboveFiltered + aboveOnlyRaw;
+  rankFiltered = 1 + stats.getNumGreater(true) + aboveFiltered;
+}
 
+// Adds to scores the weights of the selected rules that reach each
+// entity from entityId, keeping the touched entities
+void Solver::getSparseScores(int relationId, int entityId, int side,
+			     vector<double>& scores, vector<int>& touched,
+			     vector<bool>& isTouched, bool useBFS)
+{
+  Arena& arena = Arena::getThreadArena();
+  for(int j=0; j<(int)rulesselected_[relationId].size(); j++) {
+    if(rulesselected_[relationId][j] > 0) {
+      ArenaScope scope(arena); // the entities of the rule
+      const int* ids;
+      const double* values;
+      int numIds = getRuleEntities(relationId, rulesadded_[relationId][j], entityId, side, useBFS, ids, values);
+      double weight = rulesweights_[relationId][j];
+      for(int k=0; k<numIds; k++) {
+	int id = ids[k];
+	scores[id] += values ? weight*values[k] : weight;
+	if(!isTouched[id]) {
+	  isTouched[id] = true;
+	  touched.push_back(id);
+	}
+      }
+    }
+  }
 }
 
-bool Solver::shouldUpdateRanking(double basescore, double score, int rankingType)
+bool Solver::shouldUpdateRanking(double basescore, double score, int rankingType,
+				 uint32_t stream, int modifiedRelationId,
+				 int pairIndex, int side, int entityId)
 {
   // 0 is aggresive, 1 is intermediate, 2 is conservative, 3 is randomBreak
 
@@ -786,7 +1397,7 @@ bool Solver::shouldUpdateRanking(double basescore, double score, int rankingType
     if(score>basescore)
       return true;
     else
-      return (((double) rand() / (RAND_MAX))<0.5);
+      return rng_.coinFlip(stream, modifiedRelationId, 2*(uint32_t)pairIndex+side, entityId);
   }
 
   return false;
@@ -798,11 +1409,10 @@ void Solver::getRightScores(Arc* outArcWithRelation, Rule& rule, int entityId, v
   for(int i=0; i<(int)scores.size(); i++)
     scores[i] = 0.0;
 
-  set<int> destIds;
+  static thread_local vector<int> destIds;
   data_.getRightEntities(outArcWithRelation, rule, entityId, destIds, useBFS);
-  set<int>::iterator itr;
-  for(itr = destIds.begin(); itr != destIds.end(); itr++)
-    scores[*itr] += 1.0;
+  for(int k=0; k<(int)destIds.size(); k++)
+    scores[destIds[k]] += 1.0;
 }
 
 void Solver::getLeftScores(Arc* outArcWithRelation, Rule& rule, int entityId, vector<double>& scores, bool useBFS)
@@ -811,11 +1421,10 @@ void Solver::getLeftScores(Arc* outArcWithRelation, Rule& rule, int entityId, ve
   for(int i=0; i<(int)scores.size(); i++)
     scores[i] = 0.0;
 
-  set<int> origIds;
+  static thread_local vector<int> origIds;
   data_.getLeftEntities(outArcWithRelation, rule, entityId, origIds, useBFS);
-  set<int>::iterator itr;
-  for(itr = origIds.begin(); itr != origIds.end(); itr++)
-    scores[*itr] += 1.0;
+  for(int k=0; k<(int)origIds.size(); k++)
+    scores[origIds[k]] += 1.0;
 }
 
 void Solver::getRightScores(int relationId, int entityId, vector<double>& scores, bool useBFS)
@@ -824,14 +1433,15 @@ void Solver::getRightScores(int relationId, int entityId, vector<double>& scores
   for(int i=0; i<(int)scores.size(); i++)
     scores[i] = 0.0;
 
+  Arena& arena = Arena::getThreadArena();
   for(int j=0; j<(int)rulesselected_[relationId].size(); j++) {
     if(rulesselected_[relationId][j] > 0) {
-      Rule& rule = rules_[relationId][rulesadded_[relationId][j]];
-      set<int> destIds;
-      data_.getRightEntities(rule, entityId, destIds, useBFS);
-      set<int>::iterator itr;
-      for(itr = destIds.begin(); itr != destIds.end(); itr++)
-	scores[*itr] += rulesweights_[relationId][j];
+      ArenaScope scope(arena); // the entities of the rule
+      const int* destIds;
+      const double* values;
+      int num = getRuleEntities(relationId, rulesadded_[relationId][j], entityId, RuleCache::RIGHT, useBFS, destIds, values);
+      for(int k=0; k<num; k++)
+	scores[destIds[k]] += values ? rulesweights_[relationId][j]*values[k] : rulesweights_[relationId][j];
     }
   }
 
@@ -843,95 +1453,114 @@ void Solver::getLeftScores(int relationId, int entityId, vector<double>& scores,
   for(int i=0; i<(int)scores.size(); i++)
     scores[i] = 0.0;
 
+  Arena& arena = Arena::getThreadArena();
   for(int j=0; j<(int)rulesselected_[relationId].size(); j++) {
     if(rulesselected_[relationId][j] > 0) {
-      Rule& rule = rules_[relationId][rulesadded_[relationId][j]];
-      set<int> origIds;
-      data_.getLeftEntities(rule, entityId, origIds, useBFS);
-      set<int>::iterator itr;
-      for(itr = origIds.begin(); itr != origIds.end(); itr++)
-	scores[*itr] += rulesweights_[relationId][j];
+      ArenaScope scope(arena); // the entities of the rule
+      const int* origIds;
+      const double* values;
+      int num = getRuleEntities(relationId, rulesadded_[relationId][j], entityId, RuleCache::LEFT, useBFS, origIds, values);
+      for(int k=0; k<num; k++)
+	scores[origIds[k]] += values ? rulesweights_[relationId][j]*values[k] : rulesweights_[relationId][j];
     }
   }
 
 }
 
-void Solver::getRightScores(int relationId, vector<set<int> >& destIds, vector<double>& weights, map<int,double>& scores)
-{
-  for(int i=0; i<(int)destIds.size(); i++) {
-    set<int>::iterator itr;
-    for(itr = destIds[i].begin(); itr != destIds[i].end(); itr++) {
-      map<int,double>::iterator it = scores.find(*itr);
-      if(it != scores.end())
-	scores[*itr] += weights[i];
-      else
-	scores[*itr] = weights[i];
-    }
-  }
-}
-
-void Solver::getLeftScores(int relationId, vector<set<int> >& origIds, vector<double>& weights, map<int,double>& scores)
+// Adds to scores the weights of the selected rules that reach each
+// entity from entityId. The columns of rules that were not selected
+// before are added to the reachability matrix of the entity. The rules
+// and weights are taken from the arena of the thread.
+void Solver::getReachabilityScores(int relationId, int entityId, int side,
+				   ReachabilityMatrix& reach,
+				   vector<double>& scores, vector<int>& touched,
+				   vector<bool>& isTouched, bool useBFS)
 {
-  for(int i=0; i<(int)origIds.size(); i++) {
-    set<int>::iterator itr;
-    for(itr = origIds[i].begin(); itr != origIds[i].end(); itr++) {
-      map<int,double>::iterator it = scores.find(*itr);
-      if(it != scores.end())
-	scores[*itr] += weights[i];
-      else
-	scores[*itr] = weights[i];
+  Arena& arena = Arena::getThreadArena();
+  int numSelected = (int)rulesselected_[relationId].size();
+  int* ruleIds = arena.allocate<int>(numSelected);
+  double* weights = arena.allocate<double>(numSelected);
+  int numRules = 0;
+  for(int j=0; j<numSelected; j++) {
+    if(rulesselected_[relationId][j] > 0) {
+      int ruleId = rulesadded_[relationId][j];
+      if(!reach.hasRule(ruleId)) {
+	ArenaScope scope(arena); // the entities of the rule
+	const int* ids;
+	const double* values;
+	int numIds = getRuleEntities(relationId, ruleId, entityId, side, useBFS, ids, values);
+	reach.addRule(ruleId, ids, values, numIds);
+      }
+      ruleIds[numRules] = ruleId;
+      weights[numRules] = rulesweights_[relationId][j];
+      numRules++;
     }
   }
+  reach.multiply(ruleIds, weights, numRules, scores, touched, isTouched);
 }
 
-void Solver::getRightEntities(int relationId, int entityId, map<int,vector<set<int> > >& rDestIds, map<int,vector<double> >& rWeights, bool useBFS)
+void Solver::clearReachabilityScores(vector<double>& scores, vector<int>& touched,
+				     vector<bool>& isTouched)
 {
-  map<int,vector<set<int> > >::iterator it = rDestIds.find(entityId);
-  if(it == rDestIds.end()) {
-    vector<set<int> > destIds;
-    vector<double> weights;
-    for(int j=0; j<(int)rulesselected_[relationId].size(); j++) {
-      if(rulesselected_[relationId][j] > 0) {
-	Rule& rule = rules_[relationId][rulesadded_[relationId][j]];
-	set<int> tempDestIds;
-	data_.getRightEntities(rule, entityId, tempDestIds, useBFS);
-	if(tempDestIds.size()>0) {
-	  destIds.push_back(tempDestIds);
-	  weights.push_back(rulesweights_[relationId][j]);
-	}
-      }
-    }
-    rDestIds[entityId] = destIds;
-    rWeights[entityId] = weights;
+  for(int t=0; t<(int)touched.size(); t++) {
+    scores[touched[t]] = 0.0;
+    isTouched[touched[t]] = false;
   }
+  touched.clear();
 }
 
-void Solver::getLeftEntities(int relationId, int entityId, map<int,vector<set<int> > >& lOrigIds, map<int,vector<double> >& lWeights, bool useBFS)
+// Entities reached from entityId by the rule in position ruleId of the
+// rules of the relation, first looked up in the rule cache. They are
+// copied to the arena of the thread, so they are valid until the
+// enclosing ArenaScope ends. A miss is walked into a buffer of the
+// thread, and only copied to the heap when it goes into the cache.
+// With path_count_column values has the value of the number of paths
+// to each entity, and the cached vector holds the entities followed by
+// their counts; otherwise values is NULL.
+int Solver::getRuleEntities(int relationId, int ruleId, int entityId, int side, bool useBFS, const int*& entities, const double*& values)
 {
-  map<int,vector<set<int> > >::iterator it = lOrigIds.find(entityId);
-  if(it == lOrigIds.end()) {
-    vector<set<int> > origIds;
-    vector<double> weights;
-    for(int j=0; j<(int)rulesselected_[relationId].size(); j++) {
-      if(rulesselected_[relationId][j] > 0) {
-	Rule& rule = rules_[relationId][rulesadded_[relationId][j]];
-	set<int> tempOrigIds;
-	data_.getLeftEntities(rule, entityId, tempOrigIds, useBFS);
-	if(tempOrigIds.size()>0) {
-	  origIds.push_back(tempOrigIds);
-	  weights.push_back(rulesweights_[relationId][j]);
-	}
-      }
-    }
-    lOrigIds[entityId] = origIds;
-    lWeights[entityId] = weights;
-  }
+  static thread_local vector<int> sortedIds, pathCounts;
+  bool pathCountColumn = params_.getPathCountColumn();
+  shared_ptr<const vector<int> > cached = ruleCache_.find(relationId, ruleId, entityId, side);
+  const vector<int>* ids = cached.get();
+  if(!cached) {
+    Rule& rule = rules_[relationId][ruleId];
+    if(pathCountColumn) {
+      data_.getEntityPathCounts(rule, entityId, side == RuleCache::LEFT, params_.getPathCountMax(), sortedIds, pathCounts);
+      sortedIds.insert(sortedIds.end(), pathCounts.begin(), pathCounts.end());
+    }
+    else if(side == RuleCache::RIGHT)
+      data_.getRightEntities(rule, entityId, sortedIds, useBFS);
+    else
+      data_.getLeftEntities(rule, entityId, sortedIds, useBFS);
+    if(ruleCache_.isEnabled())
+      ruleCache_.insert(relationId, ruleId, entityId, side, make_shared<const vector<int> >(sortedIds));
+    ids = &sortedIds;
+  }
+
+  Arena& arena = Arena::getThreadArena();
+  int numIds = pathCountColumn ? (int)ids->size()/2 : (int)ids->size();
+  int* copiedIds = arena.allocate<int>(numIds);
+  for(int k=0; k<numIds; k++)
+    copiedIds[k] = (*ids)[k];
+  entities = copiedIds;
+  values = NULL;
+  if(pathCountColumn) {
+    double* counts = arena.allocate<double>(numIds);
+    for(int k=0; k<numIds; k++)
+      counts[k] = pathCountFeature((*ids)[numIds+k]);
+    values = counts;
+  }
+  return numIds;
 }
 
-int Solver::getMidPointRank(int rankAggressive, int numSameScore)
+int Solver::getMidPointRank(int rankAggressive, int numSameScore,
+			    int modifiedRelationId, int pairIndex, int side,
+			    bool isFiltered)
 {
   int rankMidPoint = numSameScore/2;
-  if(numSameScore % 2 != 0 && (double) rand() / (RAND_MAX)<0.5)
+  if(numSameScore % 2 != 0 &&
+     rng_.coinFlip(CounterRNG::MIDPOINT_TEST, modifiedRelationId, 2*(uint32_t)pairIndex+side, isFiltered ? 1 : 0))
     rankMidPoint += 1;
   rankMidPoint += rankAggressive;
   return rankMidPoint;
@@ -939,6 +1568,8 @@ int Solver::getMidPointRank(int rankAggressive, int numSameScore)
 
 void Solver::writeScoresToFile(int modifiedRelationId, string fname)
 {
+  ScopedTimer timer(Profile::TEST_SCORING);
+  ScopedTrace trace("writeScoresToFile", modifiedRelationId);
   int numRelations = data_.getNumberRelations();
   int relationId = modifiedRelationId;
   bool isReverse = false;
@@ -956,7 +1587,9 @@ void Solver::writeScoresToFile(int modifiedRelationId, string fname)
   bool reportLeft = params_.getReportStatsLeftRemoval();
   bool reportAll = params_.getReportStatsAllRemoval();
 
-  ofstream outfile(fname.c_str(), std::ios_base::app);
+  // relations may be scored concurrently, so the output is
+  // collected here and appended to the file at the end
+  ostringstream outfile;
 
   vector<string>& relations = data_.getRelations();
   if(printScores) {
@@ -977,21 +1610,25 @@ void Solver::writeScoresToFile(int modifiedRelationId, string fname)
   vector<pair<int,int> >& entpairs = testdata.getEntityPairs(relationId);
 
   bool useBFS = params_.getUseBreadthFirstSearch();
-  vector<double> scores((int)entities.size());
-  vector<bool> useRightEntity((int)entities.size());
-  vector<bool> useLeftEntity((int)entities.size());
+  vector<double> scores((int)entities.size(), 0.0);
+  vector<int> touched;
+  vector<bool> isTouched((int)entities.size(), false);
+  vector<int> filteredRight, filteredLeft;
+  RankStatistics stats((int)entities.size());
+  Arena& arena = Arena::getThreadArena();
   for(int i=0; i<n_pairs; i++) {
+    ArenaScope scope(arena); // the arrays of the pair
     pair<int,int>& tempcpair = entpairs[i];
     pair<int,int> cpair;
     if(isReverse) {
       cpair = pair<int,int>(tempcpair.second, tempcpair.first);
-      getEntitiesOfInterestForTail(relationId, cpair.first, useRightEntity);
-      getEntitiesOfInterestForHead(relationId, cpair.second, useLeftEntity);
+      getFilteredEntitiesForTail(relationId, cpair.first, filteredRight);
+      getFilteredEntitiesForHead(relationId, cpair.second, filteredLeft);
     }
     else {
       cpair = pair<int,int>(tempcpair.first, tempcpair.second);
-      getEntitiesOfInterestForHead(relationId, cpair.first, useRightEntity);
-      getEntitiesOfInterestForTail(relationId, cpair.second, useLeftEntity);
+      getFilteredEntitiesForHead(relationId, cpair.first, filteredRight);
+      getFilteredEntitiesForTail(relationId, cpair.second, filteredLeft);
     }
     double basescore = getScore(relationId, cpair);
     if(printScores)
@@ -1017,91 +1654,39 @@ void Solver::writeScoresToFile(int modifiedRelationId, string fname)
 
     if(reportRight || reportAll) { // remove right entities
       int origId = cpair.first;
-      getRightScores(relationId, origId, scores, useBFS);
+      getSparseScores(relationId, origId, RuleCache::RIGHT, scores, touched, isTouched, useBFS);
       assert(basescore == scores[cpair.second]);
-      for(int k=0; k<(int)entities.size(); k++) {
-	if(k != cpair.first && k != cpair.second) {
-	  double score = scores[k];
-	  if(score==basescore) {
-	    numSameScoreRightRaw++;
-	    if(useRightEntity[k])
-	      numSameScoreRightFiltered++;
-	  }
-	  if(shouldUpdateRanking(basescore, score, aggressiveType)) {
-	    rankAggressiveRightRaw++;
-	    if(useRightEntity[k])
-	      rankAggressiveRightFiltered++;
-	  }
-	  if(shouldUpdateRanking(basescore, score, randomBreakType)) {
-	    rankRandomBreakRightRaw++;
-	    if(useRightEntity[k])
-	      rankRandomBreakRightFiltered++;
-	  }
-	  if(shouldUpdateRanking(basescore, score, rankingType)) {
-	    rankRightRaw++;
-	    if(useRightEntity[k])
-	      rankRightFiltered++;
-	  }
-	  if(printScores && score > 0.0) {
-	    if(useRightEntity[k])
-	      outfile<<entities[origId]<<" "
-		     <<entities[k]<<" "
-		     <<score<<endl;
-	    else
-	      outfile<<entities[origId]<<" "
-		     <<entities[k]<<" "
-		     <<score<<"*"<<endl;
-	  }
-	}
-      }
+      stats.compute(basescore, scores, touched, cpair.first, cpair.second, filteredRight);
+      numSameScoreRightRaw = stats.getNumEqual(false);
+      numSameScoreRightFiltered = stats.getNumEqual(true);
+      getRanks(stats, aggressiveType, CounterRNG::RANDOM_BREAK_TEST, modifiedRelationId, i, RuleCache::RIGHT, rankAggressiveRightRaw, rankAggressiveRightFiltered);
+      getRanks(stats, randomBreakType, CounterRNG::RANDOM_BREAK_TEST, modifiedRelationId, i, RuleCache::RIGHT, rankRandomBreakRightRaw, rankRandomBreakRightFiltered);
+      getRanks(stats, rankingType, CounterRNG::RANDOM_BREAK_TEST, modifiedRelationId, i, RuleCache::RIGHT, rankRightRaw, rankRightFiltered);
+      if(printScores)
+	printSparseScores(outfile, origId, true, cpair, scores, touched, filteredRight);
+      clearReachabilityScores(scores, touched, isTouched);
     }
 
     if(reportLeft || reportAll) { // remove left entities
       int destId = cpair.second;
-      getLeftScores(relationId, destId, scores, useBFS);
+      getSparseScores(relationId, destId, RuleCache::LEFT, scores, touched, isTouched, useBFS);
       assert(basescore == scores[cpair.first]);
-      for(int k=0; k<(int)entities.size(); k++) {
-	if(k != cpair.first && k != cpair.second) {
-	  double score = scores[k];
-	  if(score==basescore) {
-	    numSameScoreLeftRaw++;
-	    if(useLeftEntity[k])
-	      numSameScoreLeftFiltered++;
-	  }
-	  if(shouldUpdateRanking(basescore, score, aggressiveType)) {
-	    rankAggressiveLeftRaw++;
-	    if(useLeftEntity[k])
-	      rankAggressiveLeftFiltered++;
-	  }
-	  if(shouldUpdateRanking(basescore, score, randomBreakType)) {
-	    rankRandomBreakLeftRaw++;
-	    if(useLeftEntity[k])
-	      rankRandomBreakLeftFiltered++;
-	  }
-	  if(shouldUpdateRanking(basescore, score, rankingType)) {
-	    rankLeftRaw++;
-	    if(useLeftEntity[k])
-	      rankLeftFiltered++;
-	  }
-	  if(printScores && score > 0.0) {
-	    if(useLeftEntity[k])
-	      outfile<<entities[k]<<" "
-		     <<entities[destId]<<" "
-		     <<score<<endl;
-	    else
-	      outfile<<entities[k]<<" "
-		     <<entities[destId]<<" "
-		     <<score<<"*"<<endl;
-	  }
-	}
-      }
+      stats.compute(basescore, scores, touched, cpair.first, cpair.second, filteredLeft);
+      numSameScoreLeftRaw = stats.getNumEqual(false);
+      numSameScoreLeftFiltered = stats.getNumEqual(true);
+      getRanks(stats, aggressiveType, CounterRNG::RANDOM_BREAK_TEST, modifiedRelationId, i, RuleCache::LEFT, rankAggressiveLeftRaw, rankAggressiveLeftFiltered);
+      getRanks(stats, randomBreakType, CounterRNG::RANDOM_BREAK_TEST, modifiedRelationId, i, RuleCache::LEFT, rankRandomBreakLeftRaw, rankRandomBreakLeftFiltered);
+      getRanks(stats, rankingType, CounterRNG::RANDOM_BREAK_TEST, modifiedRelationId, i, RuleCache::LEFT, rankLeftRaw, rankLeftFiltered);
+      if(printScores)
+	printSparseScores(outfile, destId, false, cpair, scores, touched, filteredLeft);
+      clearReachabilityScores(scores, touched, isTouched);
     }
 
     if(reportRight || reportAll) {
       rankingsAggressiveRightRaw_[modifiedRelationId].push_back(rankAggressiveRightRaw);
       rankingsAggressiveRightFiltered_[modifiedRelationId].push_back(rankAggressiveRightFiltered);
-      rankingsMidPointRightRaw_[modifiedRelationId].push_back(getMidPointRank(rankAggressiveRightRaw,numSameScoreRightRaw));
-      rankingsMidPointRightFiltered_[modifiedRelationId].push_back(getMidPointRank(rankAggressiveRightFiltered,numSameScoreRightFiltered));
+      rankingsMidPointRightRaw_[modifiedRelationId].push_back(getMidPointRank(rankAggressiveRightRaw,numSameScoreRightRaw,modifiedRelationId,i,RuleCache::RIGHT,false));
+      rankingsMidPointRightFiltered_[modifiedRelationId].push_back(getMidPointRank(rankAggressiveRightFiltered,numSameScoreRightFiltered,modifiedRelationId,i,RuleCache::RIGHT,true));
       rankingsRandomBreakRightRaw_[modifiedRelationId].push_back(rankRandomBreakRightRaw);
       rankingsRandomBreakRightFiltered_[modifiedRelationId].push_back(rankRandomBreakRightFiltered);
       rankingsRightRaw_[modifiedRelationId].push_back(rankRightRaw);
@@ -1110,8 +1695,8 @@ void Solver::writeScoresToFile(int modifiedRelationId, string fname)
     if(reportLeft || reportAll) {
       rankingsAggressiveLeftRaw_[modifiedRelationId].push_back(rankAggressiveLeftRaw);
       rankingsAggressiveLeftFiltered_[modifiedRelationId].push_back(rankAggressiveLeftFiltered);
-      rankingsMidPointLeftRaw_[modifiedRelationId].push_back(getMidPointRank(rankAggressiveLeftRaw,numSameScoreLeftRaw));
-      rankingsMidPointLeftFiltered_[modifiedRelationId].push_back(getMidPointRank(rankAggressiveLeftFiltered,numSameScoreLeftFiltered));
+      rankingsMidPointLeftRaw_[modifiedRelationId].push_back(getMidPointRank(rankAggressiveLeftRaw,numSameScoreLeftRaw,modifiedRelationId,i,RuleCache::LEFT,false));
+      rankingsMidPointLeftFiltered_[modifiedRelationId].push_back(getMidPointRank(rankAggressiveLeftFiltered,numSameScoreLeftFiltered,modifiedRelationId,i,RuleCache::LEFT,true));
       rankingsRandomBreakLeftRaw_[modifiedRelationId].push_back(rankRandomBreakLeftRaw);
       rankingsRandomBreakLeftFiltered_[modifiedRelationId].push_back(rankRandomBreakLeftFiltered);
       rankingsLeftRaw_[modifiedRelationId].push_back(rankLeftRaw);
@@ -1121,7 +1706,42 @@ void Solver::writeScoresToFile(int modifiedRelationId, string fname)
       outfile<<"---------------------------------"<<endl;
   }
 
-  outfile.close();
+  lock_guard<mutex> lock(outputMutex_);
+  ofstream outputfile(fname.c_str(), std::ios_base::app);
+  outputfile<<outfile.str();
+  outputfile.close();
+}
+
+// Prints the positive scores of one side of a test pair in the order of
+// the entities, marking with * the entities left out of the filtered
+// ranking
+void Solver::printSparseScores(ostream& outfile, int entityId, bool isRight,
+			       pair<int,int>& cpair, vector<double>& scores,
+			       vector<int>& touched, vector<int>& filtered)
+{
+  vector<string>& entities = data_.getEntities();
+  Arena& arena = Arena::getThreadArena();
+  int numTouched = (int)touched.size();
+  int* sortedTouched = arena.allocate<int>(numTouched);
+  copy(touched.begin(), touched.end(), sortedTouched);
+  sort(sortedTouched, sortedTouched+numTouched);
+  int numFiltered = (int)filtered.size();
+  int* sortedFiltered = arena.allocate<int>(numFiltered);
+  copy(filtered.begin(), filtered.end(), sortedFiltered);
+  sort(sortedFiltered, sortedFiltered+numFiltered);
+  for(int t=0; t<numTouched; t++) {
+    int k = sortedTouched[t];
+    double score = scores[k];
+    if(k == cpair.first || k == cpair.second || score <= 0.0)
+      continue;
+    if(isRight)
+      outfile<<entities[entityId]<<" "<<entities[k]<<" "<<score;
+    else
+      outfile<<entities[k]<<" "<<entities[entityId]<<" "<<score;
+    if(binary_search(sortedFiltered, sortedFiltered+numFiltered, k))
+      outfile<<"*";
+    outfile<<endl;
+  }
 }
 
 void Solver::findBestComplexityAndPenalty(int modifiedRelationId,
@@ -1149,8 +1769,16 @@ void Solver::findBestComplexityAndPenalty(int modifiedRelationId,
   bool reportAll = params_.getReportStatsAllRemoval();
 
   bool useBFS = params_.getUseBreadthFirstSearch();
-  map<int,set<int> > rEntities, lEntities;
-  getEntitiesOfInterest(relationId, 1, rEntities, lEntities);
+  const int* known;
+  const int* knownEnd;
+
+  // the rules do not change while the penalty and the complexity do,
+  // so what each rule reaches from a validation entity is computed once
+  ReachabilityMatrices rReach(numEntities), lReach(numEntities);
+  vector<double> scores(numEntities, 0.0);
+  vector<int> touched;
+  vector<bool> isTouched(numEntities, false);
+  Arena& arena = Arena::getThreadArena();
 
   int startComplexity = maxComplexity_[relationId];
   bestComplexity = startComplexity;
@@ -1181,17 +1809,15 @@ void Solver::findBestComplexityAndPenalty(int modifiedRelationId,
       mlp.solveModel(params_.getWriteLpFile());
       mlp.getSolution(rulesselected_[relationId], rulesweights_[relationId]);
 
+      ScopedTimer sweepTimer(Profile::VALIDATION);
       vector<int> rankingsFiltered;
       vector<string>& entities = data_.getEntities();
       TestData& validdata = data_.getValidData();
       int n_pairs = validdata.getNumEntityPairs(relationId);
       vector<pair<int,int> >& entpairs = validdata.getEntityPairs(relationId);
-      map<int,vector<set<int> > > rDestIds;
-      map<int,vector<double> > rWeights;
-      map<int,vector<set<int> > > lOrigIds;
-      map<int,vector<double> > lWeights;
       //      if(n_pairs>100) n_pairs=100;
       for(int i=0; i<n_pairs; i++) {
+	ArenaScope scope(arena); // the arrays of the pair
 	pair<int,int>& tempcpair = entpairs[i];
 	pair<int,int> cpair;
 	if(isReverse) {
@@ -1209,24 +1835,19 @@ void Solver::findBestComplexityAndPenalty(int modifiedRelationId,
 	if(reportRight || reportAll) { // remove right entities
 	  if(basescore > 0.0) {
 	    int origId = cpair.first;
-	    getRightEntities(relationId, origId, rDestIds, rWeights, useBFS);
-	    if(rDestIds[origId].size()>0) {
-	      vector<set<int> > diff(rDestIds[origId].size());
-	      for(int j=0; j<(int)rDestIds[origId].size(); j++) {
-		set_difference(rDestIds[origId][j].begin(), rDestIds[origId][j].end(), rEntities[origId].begin(), rEntities[origId].end(), inserter(diff[j], diff[j].end()));
-	      }
-	      map<int,double> scores;
-	      getRightScores(relationId, diff, rWeights[origId], scores);
-	      map<int,double>::iterator it;
-	      for(it = scores.begin(); it != scores.end(); it++) {
-		int k = it->first;
-		if(k != cpair.first && k != cpair.second) {
-		  double score = it->second;
-		  if(shouldUpdateRanking(basescore, score, rankingType))
-		    rankRightFiltered++;
-		}
+	    getReachabilityScores(relationId, origId, RuleCache::RIGHT, rReach.get(origId), scores, touched, isTouched, useBFS);
+	    knownFacts_.getEntities(relationId, KnownFacts::TRAIN_VALID, KnownFacts::RIGHT, origId, known, knownEnd);
+	    for(int t=0; t<(int)touched.size(); t++) {
+	      int k = touched[t];
+	      if(k != cpair.first && k != cpair.second && !binary_search(known, knownEnd, k)) {
+		double score = scores[k];
+		if(shouldUpdateRanking(basescore, score, rankingType, CounterRNG::RANDOM_BREAK_VALID, modifiedRelationId, i, RuleCache::RIGHT, k))
+		  rankRightFiltered++;
 	      }
+	      scores[k] = 0.0;
+	      isTouched[k] = false;
 	    }
+	    touched.clear();
 	  }
 	  else
 	    rankRightFiltered = numEntities;
@@ -1235,24 +1856,19 @@ void Solver::findBestComplexityAndPenalty(int modifiedRelationId,
 	if(reportLeft || reportAll) { // remove left entities
 	  if(basescore > 0.0) {
 	    int destId = cpair.second;
-	    getLeftEntities(relationId, destId, lOrigIds, lWeights, useBFS);
-	    if(lOrigIds[destId].size()>0) {
-	      vector<set<int> > diff(lOrigIds[destId].size());
-	      for(int j=0; j<(int)lOrigIds[destId].size(); j++) {
-		set_difference(lOrigIds[destId][j].begin(), lOrigIds[destId][j].end(), lEntities[destId].begin(), lEntities[destId].end(), inserter(diff[j], diff[j].end()));
-	      }
-	      map<int,double> scores;
-	      getLeftScores(relationId, diff, lWeights[destId], scores);
-	      map<int,double>::iterator it;
-	      for(it = scores.begin(); it != scores.end(); it++) {
-		int k = it->first;
-		if(k != cpair.first && k != cpair.second) {
-		  double score = it->second;
-		  if(shouldUpdateRanking(basescore, score, rankingType))
-		    rankLeftFiltered++;
-		}
+	    getReachabilityScores(relationId, destId, RuleCache::LEFT, lReach.get(destId), scores, touched, isTouched, useBFS);
+	    knownFacts_.getEntities(relationId, KnownFacts::TRAIN_VALID, KnownFacts::LEFT, destId, known, knownEnd);
+	    for(int t=0; t<(int)touched.size(); t++) {
+	      int k = touched[t];
+	      if(k != cpair.first && k != cpair.second && !binary_search(known, knownEnd, k)) {
+		double score = scores[k];
+		if(shouldUpdateRanking(basescore, score, rankingType, CounterRNG::RANDOM_BREAK_VALID, modifiedRelationId, i, RuleCache::LEFT, k))
+		  rankLeftFiltered++;
 	      }
+	      scores[k] = 0.0;
+	      isTouched[k] = false;
 	    }
+	    touched.clear();
 	  }
 	  else
 	    rankLeftFiltered = numEntities;
@@ -1301,24 +1917,13 @@ void Solver::findBestComplexityAndPenalty(int modifiedRelationId,
 int Solver::findBestComplexity(int modifiedRelationId,
 			       Model2MasterLP& mlp)
 {
-  bool useBFS = params_.getUseBreadthFirstSearch();
-
   int numRelations = data_.getNumberRelations();
   int relationId = modifiedRelationId;
-  bool isReverse = false;
-  if(modifiedRelationId >= numRelations) {
+  if(modifiedRelationId >= numRelations)
     relationId = modifiedRelationId - numRelations;
-    isReverse = true;
-  }
-
-  bool printScores = params_.getPrintScoresToFile();
-  int rankingType = params_.getFindBestComplexityRankingType(); // 0 is aggresive, 1 is intermediate, 2 is conservative, 3 is randomBreak
-  int aggressiveType = 0;
-  int randomBreakType = 3;
+  int numEntities = (int)(data_.getEntities().size());
 
-  bool reportRight = params_.getReportStatsRightRemoval();
-  bool reportLeft = params_.getReportStatsLeftRemoval();
-  bool reportAll = params_.getReportStatsAllRemoval();
+  bool parametric = params_.getFindBestComplexityParametric();
 
   assert(rulesselected_[relationId].size()==0);
   assert(rulesweights_[relationId].size()==0);
@@ -1329,6 +1934,13 @@ int Solver::findBestComplexity(int modifiedRelationId,
   double bestMRR = 0.0;
   int maxIter = 20;
   int iter = 0;
+  vector<double> previousSelected, previousWeights;
+  double previousMRR = 0.0;
+  int previousNumRankings = 0;
+  int numEvaluations = 0;
+  // the rules do not change while the complexity does, so what each
+  // rule reaches from a validation entity is computed once
+  ReachabilityMatrices rReach(numEntities), lReach(numEntities);
 
   while(iter<maxIter) {
     //  while(iter<maxIter && currentComplexity<=bestComplexity) {
@@ -1338,144 +1950,196 @@ int Solver::findBestComplexity(int modifiedRelationId,
     mlp.solveModel(params_.getWriteLpFile());
     mlp.getSolution(rulesselected_[relationId], rulesweights_[relationId]);
 
-    vector<int> rankingsFiltered;
-    vector<string>& entities = data_.getEntities();
-    TestData& validdata = data_.getValidData();
-    int n_pairs = validdata.getNumEntityPairs(relationId);
-    vector<pair<int,int> >& entpairs = validdata.getEntityPairs(relationId);
-    vector<double> scores((int)entities.size());
-    vector<bool> useRightEntity((int)entities.size());
-    vector<bool> useLeftEntity((int)entities.size());
-    for(int i=0; i<n_pairs; i++) {
-      pair<int,int>& tempcpair = entpairs[i];
-      pair<int,int> cpair;
-      if(isReverse) {
-	cpair = pair<int,int>(tempcpair.second, tempcpair.first);
-	getEntitiesOfInterestForTail(relationId, cpair.first, useRightEntity);
-	getEntitiesOfInterestForHead(relationId, cpair.second, useLeftEntity);
-      }
-      else {
-	cpair = pair<int,int>(tempcpair.first, tempcpair.second);
-	getEntitiesOfInterestForHead(relationId, cpair.first, useRightEntity);
-	getEntitiesOfInterestForTail(relationId, cpair.second, useLeftEntity);
-      }
-      double basescore = getScore(relationId, cpair);
-      int rankAggressiveRightRaw = 1;
-      int rankAggressiveRightFiltered = 1;
-      int rankAggressiveLeftRaw = 1;
-      int rankAggressiveLeftFiltered = 1;
-      int rankRandomBreakRightRaw = 1;
-      int rankRandomBreakRightFiltered = 1;
-      int rankRandomBreakLeftRaw = 1;
-      int rankRandomBreakLeftFiltered = 1;
-      int rankRightRaw = 1;
-      int rankRightFiltered = 1;
-      int rankLeftRaw = 1;
-      int rankLeftFiltered = 1;
-
-      if(reportRight || reportAll) { // remove right entities
-	int origId = cpair.first;
-	getRightScores(relationId, origId, scores, useBFS);
-	assert(basescore == scores[cpair.second]);
-	for(int k=0; k<(int)entities.size(); k++) {
-	  if(k != cpair.first && k != cpair.second) {
-	    double score = scores[k];
-#if 0
-	    if(shouldUpdateRanking(basescore, score, aggressiveType)) {
-	      rankAggressiveRightRaw++;
-	      if(useRightEntity[k])
-		rankAggressiveRightFiltered++;
-	    }
-	    if(shouldUpdateRanking(basescore, score, randomBreakType)) {
-	      rankRandomBreakRightRaw++;
-	      if(useRightEntity[k])
-		rankRandomBreakRightFiltered++;
-	    }
-#endif
-	    if(shouldUpdateRanking(basescore, score, rankingType)) {
-	      rankRightRaw++;
-	      if(useRightEntity[k])
-		rankRightFiltered++;
-	    }
-	  }
-	}
-      }
-
-      if(reportLeft || reportAll) { // remove left entities
-	int destId = cpair.second;
-	getLeftScores(relationId, destId, scores, useBFS);
-	assert(basescore == scores[cpair.first]);
-	for(int k=0; k<(int)entities.size(); k++) {
-	  if(k != cpair.first && k != cpair.second) {
-	    double score = scores[k];
-#if 0
-	    if(shouldUpdateRanking(basescore, score, aggressiveType)) {
-	      rankAggressiveLeftRaw++;
-	      if(useLeftEntity[k])
-		rankAggressiveLeftFiltered++;
-	    }
-	    if(shouldUpdateRanking(basescore, score, randomBreakType)) {
-	      rankRandomBreakLeftRaw++;
-	      if(useLeftEntity[k])
-		rankRandomBreakLeftFiltered++;
-	    }
-#endif
-	    if(shouldUpdateRanking(basescore, score, rankingType)) {
-	      rankLeftRaw++;
-	      if(useLeftEntity[k])
-		rankLeftFiltered++;
-	    }
-	  }
-	}
-      }
+    double mrr = 0.0;
+    int numRankings = 0;
+    if(parametric && iter > 0 &&
+       isSameSolution(previousSelected, previousWeights,
+		      rulesselected_[relationId], rulesweights_[relationId])) {
+      // same rules and weights as the previous complexity, so the
+      // validation rankings cannot change
+      mrr = previousMRR;
+      numRankings = previousNumRankings;
+      cout<<"Solution unchanged, reusing MRR"<<endl;
+    }
+    else {
+      mrr = computeValidationMRR(modifiedRelationId, rReach, lReach, numRankings);
+      numEvaluations++;
+    }
 
-      if(reportRight || reportAll) {
-	//	rankingsFiltered.push_back(rankRandomBreakRightFiltered);
-	rankingsFiltered.push_back(rankRightFiltered);
-#if 0
-	rankingsAggressiveRightRaw_[modifiedRelationId].push_back(rankAggressiveRightRaw);
-	rankingsAggressiveRightFiltered_[modifiedRelationId].push_back(rankAggressiveRightFiltered);
-	rankingsRandomBreakRightRaw_[modifiedRelationId].push_back(rankRandomBreakRightRaw);
-	rankingsRandomBreakRightFiltered_[modifiedRelationId].push_back(rankRandomBreakRightFiltered);
-	rankingsRightRaw_[modifiedRelationId].push_back(rankRightRaw);
-	rankingsRightFiltered_[modifiedRelationId].push_back(rankRightFiltered);
-#endif
-      }
-      if(reportLeft || reportAll) {
-	//	rankingsFiltered.push_back(rankRandomBreakLeftFiltered);
-	rankingsFiltered.push_back(rankLeftFiltered);
-#if 0
-	rankingsAggressiveLeftRaw_[modifiedRelationId].push_back(rankAggressiveLeftRaw);
-	rankingsAggressiveLeftFiltered_[modifiedRelationId].push_back(rankAggressiveLeftFiltered);
-	rankingsRandomBreakLeftRaw_[modifiedRelationId].push_back(rankRandomBreakLeftRaw);
-	rankingsRandomBreakLeftFiltered_[modifiedRelationId].push_back(rankRandomBreakLeftFiltered);
-	rankingsLeftRaw_[modifiedRelationId].push_back(rankLeftRaw);
-	rankingsLeftFiltered_[modifiedRelationId].push_back(rankLeftFiltered);
-#endif
-      }
+    bool complexityIsSlack = false;
+    if(parametric) {
+      double rhsLower, rhsUpper, slack;
+      double dual = mlp.getComplexitySensitivity(rhsLower, rhsUpper, slack);
+      cout<<"Complexity constraint: rhs "<<currentComplexity<<", basis range ["<<rhsLower<<", "<<rhsUpper<<"], dual "<<dual<<", slack "<<slack<<endl;
+      // once the complexity constraint is slack, a larger right hand
+      // side leaves the current solution optimal
+      complexityIsSlack = (slack > 1e-6 && fabs(dual) < 1e-9);
+      previousSelected = rulesselected_[relationId];
+      previousWeights = rulesweights_[relationId];
+      previousMRR = mrr;
+      previousNumRankings = numRankings;
     }
 
     rulesselected_[relationId].clear();
     rulesweights_[relationId].clear();
 
-    double mrr = computeMRR(rankingsFiltered);
     if(mrr >= bestMRR) {
       bestMRR = mrr;
       bestComplexity = currentComplexity;
     }
     cout<<"MRR: "<<mrr<<", bestMRR: "<<bestMRR<<", currentComplexity: "<<currentComplexity<<", bestComplexity: "<<bestComplexity<<endl;
     // if the relation doesn't exist in valid.txt, exit
-    if(rankingsFiltered.size()==0) {
+    if(numRankings==0) {
       cout<<"This relation does not exist in valid.txt"<<endl;
       break;
     }
 
+    if(complexityIsSlack) {
+      // the remaining complexities give this same solution and MRR,
+      // and ties are resolved in favor of the largest complexity
+      if(bestComplexity == currentComplexity)
+	bestComplexity = initialComplexity * maxIter;
+      cout<<"Complexity constraint is slack, skipping the remaining "<<maxIter-iter-1<<" complexities. bestComplexity: "<<bestComplexity<<endl;
+      break;
+    }
+
     iter++;
   }
+  if(parametric)
+    cout<<"Validation MRR evaluated "<<numEvaluations<<" times"<<endl;
 
   return bestComplexity;
 }
 
+// Compares two LP solutions given by the values of x and w
+bool Solver::isSameSolution(vector<double>& x1, vector<double>& w1,
+			    vector<double>& x2, vector<double>& w2)
+{
+  if(x1.size() != x2.size() || w1.size() != w2.size())
+    return false;
+  double tolerance = 1e-9;
+  for(int j=0; j<(int)x1.size(); j++)
+    if(fabs(x1[j]-x2[j]) > tolerance)
+      return false;
+  for(int j=0; j<(int)w1.size(); j++)
+    if(fabs(w1[j]-w2[j]) > tolerance)
+      return false;
+  return true;
+}
+
+// Computes the filtered MRR on the validation pairs of the relation
+// using the rules currently in rulesselected_ and rulesweights_
+double Solver::computeValidationMRR(int modifiedRelationId,
+				    ReachabilityMatrices& rReach,
+				    ReachabilityMatrices& lReach,
+				    int& numRankings)
+{
+  ScopedTimer timer(Profile::VALIDATION);
+  bool useBFS = params_.getUseBreadthFirstSearch();
+
+  int numRelations = data_.getNumberRelations();
+  int relationId = modifiedRelationId;
+  bool isReverse = false;
+  if(modifiedRelationId >= numRelations) {
+    relationId = modifiedRelationId - numRelations;
+    isReverse = true;
+  }
+
+  int rankingType = params_.getFindBestComplexityRankingType(); // 0 is aggresive, 1 is intermediate, 2 is conservative, 3 is randomBreak
+  int aggressiveType = 0;
+  int randomBreakType = 3;
+
+  bool reportRight = params_.getReportStatsRightRemoval();
+  bool reportLeft = params_.getReportStatsLeftRemoval();
+  bool reportAll = params_.getReportStatsAllRemoval();
+
+  vector<int> rankingsFiltered;
+  vector<string>& entities = data_.getEntities();
+  TestData& validdata = data_.getValidData();
+  int n_pairs = validdata.getNumEntityPairs(relationId);
+  vector<pair<int,int> >& entpairs = validdata.getEntityPairs(relationId);
+  vector<double> scores((int)entities.size(), 0.0);
+  vector<int> touched;
+  vector<bool> isTouched((int)entities.size(), false);
+  vector<int> filteredRight, filteredLeft;
+  RankStatistics stats((int)entities.size());
+  Arena& arena = Arena::getThreadArena();
+  for(int i=0; i<n_pairs; i++) {
+    ArenaScope scope(arena); // the arrays of the pair
+    pair<int,int>& tempcpair = entpairs[i];
+    pair<int,int> cpair;
+    if(isReverse) {
+      cpair = pair<int,int>(tempcpair.second, tempcpair.first);
+      getFilteredEntitiesForTail(relationId, cpair.first, filteredRight);
+      getFilteredEntitiesForHead(relationId, cpair.second, filteredLeft);
+    }
+    else {
+      cpair = pair<int,int>(tempcpair.first, tempcpair.second);
+      getFilteredEntitiesForHead(relationId, cpair.first, filteredRight);
+      getFilteredEntitiesForTail(relationId, cpair.second, filteredLeft);
+    }
+    double basescore = getScore(relationId, cpair);
+    int rankAggressiveRightRaw = 1;
+    int rankAggressiveRightFiltered = 1;
+    int rankAggressiveLeftRaw = 1;
+    int rankAggressiveLeftFiltered = 1;
+    int rankRandomBreakRightRaw = 1;
+    int rankRandomBreakRightFiltered = 1;
+    int rankRandomBreakLeftRaw = 1;
+    int rankRandomBreakLeftFiltered = 1;
+    int rankRightRaw = 1;
+    int rankRightFiltered = 1;
+    int rankLeftRaw = 1;
+    int rankLeftFiltered = 1;
+
+    if(reportRight || reportAll) { // remove right entities
+      int origId = cpair.first;
+      getReachabilityScores(relationId, origId, RuleCache::RIGHT, rReach.get(origId), scores, touched, isTouched, useBFS);
+      assert(basescore == scores[cpair.second]);
+      stats.compute(basescore, scores, touched, cpair.first, cpair.second, filteredRight);
+      getRanks(stats, rankingType, CounterRNG::RANDOM_BREAK_VALID, modifiedRelationId, i, RuleCache::RIGHT, rankRightRaw, rankRightFiltered);
+      clearReachabilityScores(scores, touched, isTouched);
+    }
+
+    if(reportLeft || reportAll) { // remove left entities
+      int destId = cpair.second;
+      getReachabilityScores(relationId, destId, RuleCache::LEFT, lReach.get(destId), scores, touched, isTouched, useBFS);
+      assert(basescore == scores[cpair.first]);
+      stats.compute(basescore, scores, touched, cpair.first, cpair.second, filteredLeft);
+      getRanks(stats, rankingType, CounterRNG::RANDOM_BREAK_VALID, modifiedRelationId, i, RuleCache::LEFT, rankLeftRaw, rankLeftFiltered);
+      clearReachabilityScores(scores, touched, isTouched);
+    }
+
+    if(reportRight || reportAll) {
+      //	rankingsFiltered.push_back(rankRandomBreakRightFiltered);
+      rankingsFiltered.push_back(rankRightFiltered);
+#if 0
+      rankingsAggressiveRightRaw_[modifiedRelationId].push_back(rankAggressiveRightRaw);
+      rankingsAggressiveRightFiltered_[modifiedRelationId].push_back(rankAggressiveRightFiltered);
+      rankingsRandomBreakRightRaw_[modifiedRelationId].push_back(rankRandomBreakRightRaw);
+      rankingsRandomBreakRightFiltered_[modifiedRelationId].push_back(rankRandomBreakRightFiltered);
+      rankingsRightRaw_[modifiedRelationId].push_back(rankRightRaw);
+      rankingsRightFiltered_[modifiedRelationId].push_back(rankRightFiltered);
+#endif
+    }
+    if(reportLeft || reportAll) {
+      //	rankingsFiltered.push_back(rankRandomBreakLeftFiltered);
+      rankingsFiltered.push_back(rankLeftFiltered);
+#if 0
+      rankingsAggressiveLeftRaw_[modifiedRelationId].push_back(rankAggressiveLeftRaw);
+      rankingsAggressiveLeftFiltered_[modifiedRelationId].push_back(rankAggressiveLeftFiltered);
+      rankingsRandomBreakLeftRaw_[modifiedRelationId].push_back(rankRandomBreakLeftRaw);
+      rankingsRandomBreakLeftFiltered_[modifiedRelationId].push_back(rankRandomBreakLeftFiltered);
+      rankingsLeftRaw_[modifiedRelationId].push_back(rankLeftRaw);
+      rankingsLeftFiltered_[modifiedRelationId].push_back(rankLeftFiltered);
+#endif
+    }
+  }
+
+  numRankings = (int)rankingsFiltered.size();
+  return computeMRR(rankingsFiltered);
+}
+
 double Solver::computeMRR(vector<int>& rankings)
 {
   double mrr = 0.0;
@@ -1865,6 +2529,8 @@ void Solver::computeStatisticsForRelations(string fname, string type, vector<vec
 
 void Solver::generateRules(int relationId, vector<Rule>& rules)
 {
+  ScopedTimer timer(Profile::GENERATE_RULES);
+  ScopedTrace trace("generateRules", relationId);
   vector<string>& relations = data_.getRelations();
   int nrelations = (int) relations.size();
   //  int relationId = params_.getRelationId();
@@ -2002,6 +2668,8 @@ void Solver::generateRulesHeuristic(int relationId,
 				    vector<double>& duals,
 				    vector<Rule>& rules)
 {
+  ScopedTimer timer(Profile::GENERATE_RULES_HEURISTIC);
+  ScopedTrace trace("generateRulesHeuristic", relationId);
   vector<string>& relations = data_.getRelations();
   int nrelations = (int) relations.size();
   int maxRuleLength = params_.getMaxRuleLength();
@@ -2090,7 +2758,7 @@ void Solver::generateRulesHeuristic(int relationId,
       for(int j=0; j<numPairsInQuery; j++) {
 	int kStart = (iter-1)*maxNumEndNodes;
 	int kEnd = kStart+maxNumEndNodes-1;
-	int index = rand() % (kEnd+1-kStart) + kStart;
+	int index = rng_.uniformInt(kEnd+1-kStart, CounterRNG::HEURISTIC_RULES + ((uint32_t)iter << 8), relationId, i, j) + kStart;
 	assert(kStart<=index && index<=kEnd);
 	// add only one node per query pair
 	//	if(pairsToNodes[j][index]>=0)
@@ -2386,6 +3054,7 @@ void Solver::getEndNodesRule(Rule& rule, vector<int>& nodeIds, vector<int>& endN
 
 void Solver::writeRulesToFile(int relationId, string fname)
 {
+  lock_guard<mutex> lock(outputMutex_);
   ofstream outfile(fname.c_str(), std::ios_base::app);
 
   string alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
@@ -2421,53 +3090,6 @@ void Solver::writeRulesToFile(int relationId, string fname)
   outfile.close();
 }
 
-void separateRelationsAndEntities(string input, vector<string>& output)
-{
-  istringstream ss( input );
-  string s;
-  getline( ss, s, '(' );
-  output.push_back(s);
-  getline( ss, s, ',' );
-  output.push_back(s);
-  getline( ss, s, ')' );
-  output.push_back(s);
-
-#if 0
-  for(int i=0; i<(int)output.size(); i++) {
-    cout<<output[i]<<" ";
-  }
-  cout<<endl;
-#endif
-}
-
-void separateStrings(string input, vector<vector<string> >& output)
-{
-  string s;
-  string stemp1, stemp2, stemp3;
-  istringstream ss( input );
-  int counter=1;
-  vector<string> values;
-  while (ss) {
-    string s;
-    if (!getline( ss, s, ' ' )) break;
-    if(s.compare("<=")==0) continue;
-    if(s.back() == ',') s.pop_back();
-    values.push_back(s);
-    counter++;
-  }
-#if 0
-  for(int i=0; i<(int)values.size(); i++)
-    cout<<values[i]<<" ";
-  cout<<endl;
-#endif
-  for(int i=0; i<(int)values.size(); i++) {
-    vector<string> relents;
-    separateRelationsAndEntities(values[i], relents);
-    assert(relents.size() > 0);
-    output.push_back(relents);
-  }
-}
-
 void Solver::readRulesFromFile(string fname)
 {
   ifstream infile(fname.c_str());
@@ -16,9 +16,22 @@
 
 #include <vector>
 #include <cstring>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <memory>
 
 #include "Data.hpp"
 #include "Model2MasterLP.hpp"
+#include "ThreadBudget.hpp"
+#include "RuleCache.hpp"
+#include "ReachabilityMatrix.hpp"
+#include "RankStatistics.hpp"
+#include "KnownFacts.hpp"
+#include "Arena.hpp"
+#include "CounterRNG.hpp"
+#include "Profile.hpp"
+#include "Trace.hpp"
 #include <ilcplex/ilocplex.h>
 
 using namespace std;
@@ -53,6 +66,27 @@ public:
 
 };
 
+// Summary of the sampled estimates of the pairs of extra coverage of
+// the rules of a relation (neg_k_estimator), printed once the columns
+// are built. add() can be called from several threads.
+class ExtraCoverageSummary {
+private:
+  mutex mutex_;
+  int numRules_;
+  long numSampled_;
+  long numAnchors_;
+  double sumRelativeHalfWidth_;
+  double maxRelativeHalfWidth_;
+
+public:
+  ExtraCoverageSummary():numRules_(0),numSampled_(0),numAnchors_(0),
+			 sumRelativeHalfWidth_(0.0),maxRelativeHalfWidth_(0.0) {}
+  ~ExtraCoverageSummary() {}
+
+  void add(double estimate, double halfWidth, int numSampled, int numAnchors);
+  void print(int relationId);
+};
+
 class Solver {
 private:
   Parameters& params_;
@@ -68,6 +102,15 @@ private:
 
   vector<Rankings> rankings_;
 
+  ThreadBudget threadBudget_;
+  mutex outputMutex_; // protects the scores and rules files
+  KnownFacts knownFacts_; // pairs of train, valid and test by relation and entity, built after reading the data
+  RuleCache ruleCache_; // entities reached by the selected rules, shared by validation and test scoring
+  CounterRNG rng_; // random tie breaks and choices, independent of the evaluation order
+  vector<vector<int> > sampleOrders_; // by relation and side, the order in which neg_k_estimator samples the keys of KnownFacts
+  Profile runProfile_; // phases that are not specific to a relation, e.g. reading the data
+  vector<unique_ptr<Profile> > profiles_; // one per modified relation id, empty if write_profile is false
+
   vector<vector<int> > rankingsAggressiveRightRaw_;
   vector<vector<int> > rankingsAggressiveRightFiltered_;
   vector<vector<int> > rankingsAggressiveLeftRaw_;
@@ -91,38 +134,76 @@ private:
 public:
   Solver(Parameters& params):
     params_(params), 
-    data_(params.getMaxComplexity())
+    data_(params.getMaxComplexity()),
+    threadBudget_(params.getNumberThreads()),
+    ruleCache_((size_t)params.getRuleCacheSizeMB()*1024*1024),
+    rng_(1234)
     //    maxComplexity_(params.getMaxComplexity())
   {setMinPercentCoverage(0.0);}
   ~Solver() {}
 
   enum Side {left, right, both};
+  Data& getData() {return data_;}
+  KnownFacts& getKnownFacts() {return knownFacts_;}
   void setMaxComplexity(int relationId, int maxComplexity) {maxComplexity_[relationId]=maxComplexity;}
   void setMinPercentCoverage(double minCov);
   void run(string scoresFileName, string rulesFileName, string inputRulesFileName);
+  void runRelationsWorker(vector<int>& relationIds, atomic<int>& nextRelation,
+			  string scoresFileName, string rulesFileName);
+  void runRelation(int relationId, string scoresFileName, string rulesFileName);
+  void writeProfileToFile(string fname);
   void runOneRelation(int relationId);
   void setBestSettingsModel2(int relationId, Model2MasterLP& mlp);
   void runColumnGenerationOneRelation(int relationId);
+  double getRelativeGap(double objValue, double bound);
   void printSolution(int relationId, bool printAll=false);
   int getNumPairsExtraCoverage(int modifiedRelationId, Rule& rule,
-			       vector<int>& column);
+			       vector<int>& column,
+			       ExtraCoverageSummary* summary=NULL);
+  int getNumPairsExtraCoverage(int modifiedRelationId, Rule& rule,
+			       ExtraCoverageSummary* summary=NULL);
+  int getNumPairsExtraCoverage(int relationId, Rule& rule, int side, int k,
+			       vector<int>& entities, bool useBFS);
+  bool getCoverageColumn(int relationId, Rule& rule, vector<int>& column);
+  bool addRuleColumn(Model2MasterLP& mlp, int relationId, Rule& rule, vector<int>* column, double objPenalty,
+		     vector<double>* countColumn=NULL);
+  void getPathCountColumn(int relationId, Rule& rule, vector<double>& column);
+  void getNumPairsExtraCoverageBatch(int relationId, vector<int>& ruleIds,
+				     int numThreads,
+				     vector<int>& numPairsExtraCov);
+  void addRuleColumnsWithExtraCoverage(int relationId, Model2MasterLP& mlp,
+				       double objPenalty);
+  void buildSampleOrders();
+  double estimateNumPairsExtraCoverage(int relationId, Rule& rule,
+				       double& halfWidth,
+				       int& numSampled, int& numAnchors);
+  void priceNewRules(int relationId, Model2MasterLP& mlp,
+		     int firstRule, vector<double>& duals_con11,
+		     vector<int>& rulesToAdd,
+		     vector<vector<int> >& columns,
+		     vector<vector<double> >& countColumns,
+		     vector<int>& numPairsExtraCov,
+		     vector<double>& reducedCosts);
   void getColumnForRule(int modifiedRelationId, Rule& rule,
 			vector<double>& column);
   double getScore(int relationId, Rule& rule, int cpairId);
   double getScore(int relationId, pair<int,int>& cpair);
-  void getEntitiesOfInterest(int relationId, int whichCombination, map<int,set<int> >& rEntities, map<int,set<int> >& lEntities);
   void getEntitiesOfInterestForHead(int relationId, int tail, vector<bool>& useEntity, bool useAllData=true);
   void getEntitiesOfInterestForTail(int relationId, int head, vector<bool>& useEntity, bool useAllData=true);
-  bool shouldUpdateRanking(double basescore, double score, int rankingType);
+  void getFilteredEntitiesForHead(int relationId, int tail, vector<int>& filtered, bool useAllData=true);
+  void getFilteredEntitiesForTail(int relationId, int head, vector<int>& filtered, bool useAllData=true);
+  void getRanks(RankStatistics& stats, int rankingType, uint32_t stream, int modifiedRelationId, int pairIndex, int side, int& rankRaw, int& rankFiltered);
+  void getSparseScores(int relationId, int entityId, int side, vector<double>& scores, vector<int>& touched, vector<bool>& isTouched, bool useBFS);
+  void printSparseScores(ostream& outfile, int entityId, bool isRight, pair<int,int>& cpair, vector<double>& scores, vector<int>& touched, vector<int>& filtered);
+  bool shouldUpdateRanking(double basescore, double score, int rankingType, uint32_t stream, int modifiedRelationId, int pairIndex, int side, int entityId);
   void getRightScores(Arc* outArcWithRelation, Rule& rule, int entityId, vector<double>& scores, bool useBFS);
   void getLeftScores(Arc* outArcWithRelation, Rule& rule, int entityId, vector<double>& scores, bool useBFS);
   void getRightScores(int relationId, int entityId, vector<double>& scores, bool useBFS);
   void getLeftScores(int relationId, int entityId, vector<double>& scores, bool useBFS);
-  void getRightScores(int relationId, vector<set<int> >& destIds, vector<double>& weights, map<int,double>& scores);
-  void getLeftScores(int relationId, vector<set<int> >& origIds, vector<double>& weights, map<int,double>& scores);
-  void getRightEntities(int relationId, int entityId, map<int,vector<set<int> > >& rDestIds, map<int,vector<double> >& rWeights, bool useBFS);
-  void getLeftEntities(int relationId, int entityId, map<int,vector<set<int> > >& lOrigIds, map<int,vector<double> >& lWeights, bool useBFS);
-  int getMidPointRank(int rankAggressive, int numSameScore);
+  void getReachabilityScores(int relationId, int entityId, int side, ReachabilityMatrix& reach, vector<double>& scores, vector<int>& touched, vector<bool>& isTouched, bool useBFS);
+  void clearReachabilityScores(vector<double>& scores, vector<int>& touched, vector<bool>& isTouched);
+  int getRuleEntities(int relationId, int ruleId, int entityId, int side, bool useBFS, const int*& entities, const double*& values);
+  int getMidPointRank(int rankAggressive, int numSameScore, int modifiedRelationId, int pairIndex, int side, bool isFiltered);
   void writeScoresToFile(int relationId, string fname);
   void findBestComplexityAndPenalty(int modifiedRelationId,
 				    Model2MasterLP& mlp,
@@ -130,6 +211,9 @@ public:
 				    double& bestPenalty);
   int findBestComplexity(int modifiedRelationId,
 			 Model2MasterLP& mlp);
+  bool isSameSolution(vector<double>& x1, vector<double>& w1,
+		      vector<double>& x2, vector<double>& w2);
+  double computeValidationMRR(int modifiedRelationId, ReachabilityMatrices& rReach, ReachabilityMatrices& lReach, int& numRankings);
   double computeMRR(vector<int>& rankings);
   void computeStatistics(string fname, string type, vector<vector<int> >& rankingsAggressive, vector<vector<int> >& rankingsMidPoint, vector<vector<int> >& rankingsRandomBreak, vector<vector<int> >& rankings, bool isFiltered);
   void computeStatisticsForRelations(string fname, string type, vector<vector<int> >& rankingsAggressive, vector<vector<int> >& rankingsMidPoint, vector<vector<int> >& rankingsRandomBreak, vector<vector<int> >& rankings, bool isFiltered);
@@ -28,10 +28,12 @@ int Solver::find_sp(int snode, int enode, int relid, Arc* ar, vector<int> & dist
   
   while (distance[enode] < 0 && curdist < maxRuleLength && spos <= epos){
     int cnode = stack[spos];
+    Profile::count(Profile::BFS_NODES_EXPANDED);
     spos ++;
     if (distance[cnode] > curdist) curdist = distance[cnode];
     
     vector<Arc*> &outarcs = data_.getOutArcs()[cnode];
+    Profile::count(Profile::EDGES_SCANNED, outarcs.size());
     for (int j=0; j<outarcs.size(); j++){
       if (ar != NULL && outarcs[j] == ar) continue;
       int nextnode = outarcs[j]->getHead()->getId();
@@ -53,6 +55,7 @@ int Solver::find_sp(int snode, int enode, int relid, Arc* ar, vector<int> & dist
     if (!useReverseArcs) continue;
     
     vector<Arc*> &inarcs = data_.getInArcs()[cnode];
+    Profile::count(Profile::EDGES_SCANNED, inarcs.size());
     for (int j=0; j<inarcs.size(); j++){
       if (ar != NULL && inarcs[j] == ar) continue;
       int nextnode = inarcs[j]->getTail()->getId();
@@ -127,10 +130,12 @@ int Solver::find_sp2(int snode, int enode, int truedist, int relid, Arc* ar, vec
   
   while (distance[enode] < 0 && curdist < maxRuleLength && spos <= epos){
     int cnode = stack[spos];
+    Profile::count(Profile::BFS_NODES_EXPANDED);
     spos ++;
     if (distance[cnode] > curdist) curdist = distance[cnode];
     
     vector<Arc*> &outarcs = data_.getOutArcs()[cnode];
+    Profile::count(Profile::EDGES_SCANNED, outarcs.size());
     for (int j=0; j<outarcs.size(); j++){
       if (ar != NULL && outarcs[j] == ar) continue;
       int nextnode = outarcs[j]->getHead()->getId();
@@ -153,6 +158,7 @@ int Solver::find_sp2(int snode, int enode, int truedist, int relid, Arc* ar, vec
     if (!useReverseArcs) continue;
     
     vector<Arc*> &inarcs = data_.getInArcs()[cnode];
+    Profile::count(Profile::EDGES_SCANNED, inarcs.size());
     for (int j=0; j<inarcs.size(); j++){
       if (ar != NULL && inarcs[j] == ar) continue;
       int nextnode = inarcs[j]->getTail()->getId();
@@ -212,6 +218,8 @@ int Solver::find_sp2(int snode, int enode, int truedist, int relid, Arc* ar, vec
 
 void Solver::generateRulesS0(int relationId, vector<Rule>& rules)
 {
+  ScopedTimer timer(Profile::GENERATE_RULES_S0);
+  ScopedTrace trace("generateRulesS0", relationId);
   vector<string>& relations = data_.getRelations();
   int nrelations = (int) relations.size();
   //  int relationId = params_.getRelationId();
@@ -593,6 +601,8 @@ void Solver::generateRulesS1(int relationId, vector<Rule>& rules)
 
 void Solver::generateRulesS2(int relationId, vector<Rule>& rules)
 {
+  ScopedTimer timer(Profile::GENERATE_RULES_S2);
+  ScopedTrace trace("generateRulesS2", relationId);
   vector<string>& relations = data_.getRelations();
   int nrelations = (int) relations.size();
   //  int relationId = params_.getRelationId();
@@ -906,10 +916,12 @@ int Solver::find_sp_1(int snode, int enode, int relid, Arc* ar, vector<int> & di
   
   while (distance[enode] < 0 && curdist < maxRuleLength && spos <= epos){
     int cnode = stack[spos];
+    Profile::count(Profile::BFS_NODES_EXPANDED);
     spos ++;
     if (distance[cnode] > curdist) curdist = distance[cnode];
     
     vector<Arc*> &outarcs = data_.getOutArcs()[cnode];
+    Profile::count(Profile::EDGES_SCANNED, outarcs.size());
     for (int j=0; j<outarcs.size(); j++){
       if (ar != NULL && outarcs[j] == ar) continue;
       int nextnode = outarcs[j]->getHead()->getId();
@@ -931,6 +943,7 @@ int Solver::find_sp_1(int snode, int enode, int relid, Arc* ar, vector<int> & di
     if (!useReverseArcs) continue;
     
     vector<Arc*> &inarcs = data_.getInArcs()[cnode];
+    Profile::count(Profile::EDGES_SCANNED, inarcs.size());
     for (int j=0; j<inarcs.size(); j++){
       if (ar != NULL && inarcs[j] == ar) continue;
       int nextnode = inarcs[j]->getTail()->getId();
@@ -996,6 +1009,8 @@ public:
 
 void Solver::generateRulesS0Duals(int relationId, vector<Rule>& rules, vector<double>& duals, int maxRuleLength)
 {
+  ScopedTimer timer(Profile::GENERATE_RULES_S0_DUALS);
+  ScopedTrace trace("generateRulesS0Duals", relationId);
   vector<string>& relations = data_.getRelations();
   int nrelations = (int) relations.size();
   //  int relationId = params_.getRelationId();
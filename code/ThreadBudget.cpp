@@ -0,0 +1,43 @@
+// © Copyright IBM Corporation 2022. All Rights Reserved.
+// LICENSE: Eclipse Public License - v 2.0, https://opensource.org/licenses/EPL-2.0
+// SPDX-License-Identifier: EPL-2.0
+
+#include "ThreadBudget.hpp"
+
+#include <cassert>
+#include <algorithm>
+
+using namespace std;
+
+void ThreadBudget::setTotal(int total)
+{
+  lock_guard<mutex> lock(mutex_);
+  assert(total_ == available_); // nobody is holding threads
+  if(total < 1)
+    total = 1;
+  total_ = total;
+  available_ = total;
+}
+
+int ThreadBudget::getAvailable()
+{
+  lock_guard<mutex> lock(mutex_);
+  return available_;
+}
+
+int ThreadBudget::acquire(int requested)
+{
+  lock_guard<mutex> lock(mutex_);
+  int granted = min(requested, available_);
+  if(granted < 0)
+    granted = 0;
+  available_ -= granted;
+  return granted;
+}
+
+void ThreadBudget::release(int granted)
+{
+  lock_guard<mutex> lock(mutex_);
+  available_ += granted;
+  assert(available_ <= total_);
+}
@@ -0,0 +1,34 @@
+// © Copyright IBM Corporation 2022. All Rights Reserved.
+// LICENSE: Eclipse Public License - v 2.0, https://opensource.org/licenses/EPL-2.0
+// SPDX-License-Identifier: EPL-2.0
+
+#ifndef __THREADBUDGET_HPP__
+#define __THREADBUDGET_HPP__
+
+#include <mutex>
+
+using namespace std;
+
+// Process-wide pool of threads shared by the relations that are
+// solved concurrently. Every relation holds one thread while it runs;
+// large LPs and the pricing of candidate rules ask for extra threads,
+// which become available as the other relations finish.
+class ThreadBudget {
+private:
+  mutex mutex_;
+  int total_;
+  int available_;
+
+public:
+  ThreadBudget(int total=1):total_(total),available_(total) {}
+  ~ThreadBudget() {}
+
+  void setTotal(int total);
+  int getTotal() {return total_;}
+  int getAvailable();
+
+  int acquire(int requested); // never blocks, returns the number of threads granted (possibly 0)
+  void release(int granted);
+};
+
+#endif
@@ -0,0 +1,87 @@
+// © Copyright IBM Corporation 2022. All Rights Reserved.
+// LICENSE: Eclipse Public License - v 2.0, https://opensource.org/licenses/EPL-2.0
+// SPDX-License-Identifier: EPL-2.0
+
+#include "Trace.hpp"
+
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+atomic<bool> Trace::enabled_(false);
+chrono::steady_clock::time_point Trace::origin_;
+mutex Trace::registryMutex_;
+vector<unique_ptr<Trace::ThreadBuffer> > Trace::buffers_;
+atomic<int> Trace::generation_(0);
+thread_local Trace::ThreadBuffer* Trace::buffer_ = NULL;
+thread_local int Trace::bufferGeneration_ = -1;
+
+void Trace::enable()
+{
+  origin_ = chrono::steady_clock::now();
+  enabled_ = true;
+}
+
+long long Trace::now()
+{
+  chrono::microseconds elapsed = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - origin_);
+  return elapsed.count();
+}
+
+Trace::ThreadBuffer* Trace::registerThread()
+{
+  ThreadBuffer* buffer = new ThreadBuffer();
+  lock_guard<mutex> lock(registryMutex_);
+  buffer->threadId = (int)buffers_.size();
+  buffers_.push_back(unique_ptr<ThreadBuffer>(buffer));
+  bufferGeneration_ = generation_.load();
+  return buffer;
+}
+
+void Trace::record(const char* name, int relationId, long long begin, long long end)
+{
+  if(buffer_ == NULL || bufferGeneration_ != generation_.load(memory_order_relaxed))
+    buffer_ = registerThread();
+  Event event = {name, relationId, begin, end};
+  buffer_->events.push_back(event);
+}
+
+void Trace::clear()
+{
+  lock_guard<mutex> lock(registryMutex_);
+  buffers_.clear();
+  generation_++;
+}
+
+void Trace::writeToFile(string fname)
+{
+  unique_lock<mutex> lock(registryMutex_);
+  enabled_ = false;
+
+  ofstream outfile(fname.c_str());
+  outfile<<"{\"displayTimeUnit\": \"ms\", \"traceEvents\": ["<<endl;
+  bool first = true;
+  for(int i=0; i<(int)buffers_.size(); i++) {
+    ThreadBuffer* buffer = buffers_[i].get();
+    if(!first)
+      outfile<<","<<endl;
+    first = false;
+    outfile<<"{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": "<<buffer->threadId
+	   <<", \"args\": {\"name\": \"thread "<<buffer->threadId<<"\"}}";
+    for(int j=0; j<(int)buffer->events.size(); j++) {
+      Event& event = buffer->events[j];
+      outfile<<","<<endl;
+      outfile<<"{\"name\": \""<<event.name<<"\", \"ph\": \"X\", \"pid\": 1, \"tid\": "<<buffer->threadId
+	     <<", \"ts\": "<<event.begin<<", \"dur\": "<<event.end-event.begin;
+      if(event.relationId >= 0)
+	outfile<<", \"args\": {\"relation\": "<<event.relationId<<"}";
+      outfile<<"}";
+    }
+  }
+  outfile<<endl<<"]}"<<endl;
+  outfile.close();
+  lock.unlock();
+  clear();
+  cout<<"Trace written to "<<fname<<endl;
+}
@@ -0,0 +1,74 @@
+// © Copyright IBM Corporation 2022. All Rights Reserved.
+// LICENSE: Eclipse Public License - v 2.0, https://opensource.org/licenses/EPL-2.0
+// SPDX-License-Identifier: EPL-2.0
+
+#ifndef __TRACE_HPP__
+#define __TRACE_HPP__
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+using namespace std;
+
+// Timeline of what each thread runs, written in the Chrome trace event
+// format so that it can be opened with chrome://tracing or Perfetto.
+// Every thread appends its spans to its own buffer without locking;
+// the mutex is only taken the first time a thread records a span, to
+// register its buffer. The registry owns the buffers. writeToFile() and
+// clear() must be called once the traced threads have finished, since
+// they read and free the buffers without their threads. Threads that
+// outlive them (e.g. those of the OpenMP pool) keep a pointer to their
+// old buffer, so each buffer is tagged with the generation of the
+// registry and a thread registers a new one after a clear().
+class Trace {
+private:
+  struct Event {
+    const char* name;
+    int relationId;
+    long long begin; // microseconds since enable()
+    long long end;
+  };
+  struct ThreadBuffer {
+    int threadId;
+    vector<Event> events;
+  };
+
+  static atomic<bool> enabled_;
+  static chrono::steady_clock::time_point origin_;
+  static mutex registryMutex_;
+  static vector<unique_ptr<ThreadBuffer> > buffers_;
+  static atomic<int> generation_; // incremented by clear()
+  static thread_local ThreadBuffer* buffer_;
+  static thread_local int bufferGeneration_;
+
+  static ThreadBuffer* registerThread();
+
+public:
+  static void enable();
+  static bool isEnabled() {return enabled_.load(memory_order_relaxed);}
+  static long long now();
+  static void record(const char* name, int relationId, long long begin, long long end);
+  static void writeToFile(string fname); // also clears the trace
+  static void clear(); // releases the buffers
+};
+
+// Records the enclosing scope as a span of the calling thread. name
+// must be a string literal or otherwise outlive the trace.
+class ScopedTrace {
+private:
+  const char* name_;
+  int relationId_;
+  long long begin_;
+
+public:
+  ScopedTrace(const char* name, int relationId=-1):name_(name),relationId_(relationId),begin_(-1)
+  {if(Trace::isEnabled()) begin_ = Trace::now();}
+  ~ScopedTrace()
+  {if(begin_ >= 0) Trace::record(name_, relationId_, begin_, Trace::now());}
+};
+
+#endif
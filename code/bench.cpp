@@ -0,0 +1,327 @@
+// © Copyright IBM Corporation 2022. All Rights Reserved.
+// LICENSE: Eclipse Public License - v 2.0, https://opensource.org/licenses/EPL-2.0
+// SPDX-License-Identifier: EPL-2.0
+
+// Microbenchmarks of the path search kernels, to compare changes to
+// them. For every data directory (and optionally a synthetic graph),
+// rule length, kind of anchor entity and setting of repeated nodes, it
+// times
+//   hasPathDfs           rule from an anchor to a random entity
+//   hasPath              the same with the walks planned (plan_rule_walks)
+//   rightEntities        entities reached by a rule from an anchor (BFS, DFS and planned)
+//   leftEntities         entities that reach an anchor by a rule (BFS, DFS and planned)
+//   find_sp              shortest path between an anchor and the end of a walk
+//   entitiesOfInterest   getEntitiesOfInterestForHead for an anchor
+// and prints one line per case with the time per operation and the
+// number of arcs scanned per second. The rules are random walks from
+// the anchors, so that they are never empty. Hubs are the entities with
+// the largest degree, leaves are random entities of degree 1 or 2.
+
+#include "Parameters.hpp"
+#include "Solver.hpp"
+#include "KGGenerator.hpp"
+#include "Profile.hpp"
+#include "CounterRNG.hpp"
+
+#include <iomanip>
+#include <chrono>
+#include <functional>
+
+using namespace std;
+
+struct BenchmarkCase {
+  vector<int> anchors;
+  vector<Rule> rulesFrom; // walk that starts at the anchor
+  vector<Rule> rulesTo; // the same walk reversed, so that it ends at the anchor
+  vector<int> ends; // last entity of the walk
+  vector<int> others; // random entity
+};
+
+void selectAnchors(Data& data, int numAnchors, CounterRNG& rng,
+		   vector<int>& hubs, vector<int>& leaves)
+{
+  vector<vector<Arc*> >& outarcs = data.getOutArcs();
+  vector<vector<Arc*> >& inarcs = data.getInArcs();
+  int numEntities = data.getNumberNodes();
+
+  vector<pair<int,int> > degrees;
+  vector<int> candidates;
+  for(int i=0; i<numEntities; i++) {
+    int degree = (int)(outarcs[i].size() + inarcs[i].size());
+    if(degree == 0) continue;
+    degrees.push_back(pair<int,int>(-degree, i));
+    if(degree <= 2)
+      candidates.push_back(i);
+  }
+  sort(degrees.begin(), degrees.end());
+
+  hubs.clear();
+  for(int i=0; i<(int)degrees.size() && i<numAnchors; i++)
+    hubs.push_back(degrees[i].second);
+
+  leaves.clear();
+  if((int)candidates.size() <= numAnchors) {
+    // not enough entities of degree 1 or 2, take the smallest degrees
+    for(int i=(int)degrees.size()-1; i>=0 && (int)leaves.size()<numAnchors; i--)
+      leaves.push_back(degrees[i].second);
+  }
+  else {
+    for(int i=0; i<numAnchors; i++) {
+      int j = i + rng.uniformInt((int)candidates.size()-i, CounterRNG::BENCHMARK, 0, i, 0);
+      swap(candidates[i], candidates[j]);
+      leaves.push_back(candidates[i]);
+    }
+  }
+}
+
+// random arcs tried at each step of a walk before it is given up
+const int MAX_WALK_ATTEMPTS = 64;
+
+// Random walk of the given length that can follow the arcs in both
+// directions and does not go back through the arc it just used when
+// there is another choice. Returns false if it gets stuck.
+bool randomWalkRule(Data& data, int start, int length, CounterRNG& rng,
+		    uint32_t key, Rule& rule, int& end)
+{
+  vector<vector<Arc*> >& outarcs = data.getOutArcs();
+  vector<vector<Arc*> >& inarcs = data.getInArcs();
+
+  int node = start;
+  Arc* previous = NULL;
+  for(int j=0; j<length; j++) {
+    int numOut = (int)outarcs[node].size();
+    int numArcs = numOut + (int)inarcs[node].size();
+    if(numArcs == 0 || (numArcs == 1 && previous != NULL))
+      return false;
+    // a self-loop is both an out and an in arc of the node, so the
+    // only other arc may be the previous one again: the attempts are
+    // bounded and the walk is given up
+    Arc* arc = previous;
+    bool isReverse = false;
+    for(int attempt=0; arc == previous; attempt++) {
+      if(attempt == MAX_WALK_ATTEMPTS)
+	return false;
+      int k = rng.uniformInt(numArcs, CounterRNG::BENCHMARK, key, j, attempt);
+      isReverse = (k >= numOut);
+      arc = (isReverse ? inarcs[node][k-numOut] : outarcs[node][k]);
+    }
+    rule.addRelationId(arc->getIdRelation(), isReverse);
+    node = (isReverse ? arc->getTail()->getId() : arc->getHead()->getId());
+    previous = arc;
+  }
+  end = node;
+  return true;
+}
+
+Rule reverseRule(Rule& rule)
+{
+  Rule reversed;
+  vector<int>& relationIds = rule.getRelationIds();
+  vector<bool>& isReverseArc = rule.getIsReverseArc();
+  for(int j=rule.getLengthRule()-1; j>=0; j--)
+    reversed.addRelationId(relationIds[j], !isReverseArc[j]);
+  return reversed;
+}
+
+void buildCase(Data& data, vector<int>& anchors, int length, CounterRNG& rng,
+	       uint32_t key, BenchmarkCase& bcase)
+{
+  int numEntities = data.getNumberNodes();
+  for(int i=0; i<(int)anchors.size(); i++) {
+    Rule rule;
+    int end;
+    if(!randomWalkRule(data, anchors[i], length, rng, key+i, rule, end))
+      continue;
+    bcase.anchors.push_back(anchors[i]);
+    bcase.rulesFrom.push_back(rule);
+    bcase.rulesTo.push_back(reverseRule(rule));
+    bcase.ends.push_back(end);
+    bcase.others.push_back(rng.uniformInt(numEntities, CounterRNG::BENCHMARK, key+i, length, 1000));
+  }
+}
+
+// Runs pass (one operation per anchor) until minSeconds have elapsed
+// and prints the time per operation and the arcs scanned per second
+void timeKernel(string dataset, string kernel, string search, bool repeated,
+		int length, string anchorType, int numOps, double minSeconds,
+		function<void()> pass)
+{
+  if(numOps == 0)
+    return;
+  Profile profile;
+  long ops = 0;
+  chrono::duration<double> elapsed(0.0);
+  {
+    ScopedProfile scopedProfile(&profile);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    do {
+      pass();
+      ops += numOps;
+      elapsed = chrono::steady_clock::now() - start;
+    } while(elapsed.count() < minSeconds);
+  }
+  double nsPerOp = 1.0e9 * elapsed.count() / ops;
+  double edgesPerSec = profile.getCounter(Profile::EDGES_SCANNED) / elapsed.count();
+  cout<<left<<setw(12)<<dataset<<" "<<setw(18)<<kernel<<" "<<setw(4)<<search
+      <<" "<<setw(8)<<(repeated ? "yes" : "no")<<" "<<right<<setw(6)<<length
+      <<" "<<left<<setw(7)<<anchorType<<" "<<right<<setw(10)<<ops
+      <<" "<<setw(12)<<fixed<<setprecision(1)<<nsPerOp
+      <<" "<<setw(12)<<scientific<<setprecision(3)<<edgesPerSec<<endl;
+  cout.unsetf(ios_base::floatfield);
+}
+
+void runBenchmarks(string dataset, Parameters& params, int numAnchors,
+		   int maxLength, double minSeconds)
+{
+  Solver solver(params);
+  Data& data = solver.getData();
+  data.readData(params);
+  solver.getKnownFacts().build(data);
+  if(data.getArcs().size() == 0) {
+    cout<<dataset<<": no training triples in "<<params.getDirectory()<<", skipped"<<endl;
+    return;
+  }
+  int numEntities = data.getNumberNodes();
+  int numRelations = data.getNumberRelations();
+
+  CounterRNG rng(1234);
+  vector<int> hubs, leaves;
+  selectAnchors(data, numAnchors, rng, hubs, leaves);
+  vector<int>* anchorSets[2] = {&hubs, &leaves};
+  string anchorTypes[2] = {"hub", "leaf"};
+
+  vector<int> distance(numEntities, -1), prev(numEntities, -1), prevrel(numEntities, -1);
+  set<int> tnodes;
+  vector<int> firstrel(numRelations, 1), firstinvrel(numRelations, 1);
+  vector<bool> useEntity(numEntities);
+
+  for(int irep=0; irep<2; irep++) {
+    bool repeated = (irep == 1);
+    data.setRepeatedNodesAllowed(repeated);
+    for(int length=1; length<=maxLength; length++) {
+      for(int a=0; a<2; a++) {
+	BenchmarkCase bcase;
+	buildCase(data, *anchorSets[a], length, rng, (uint32_t)(1000*(a+1)), bcase);
+	int n = (int)bcase.anchors.size();
+	string anchorType = anchorTypes[a];
+
+	timeKernel(dataset, "hasPathDfs", "DFS", repeated, length, anchorType, n, minSeconds, [&]() {
+	    for(int i=0; i<n; i++) {
+	      pair<int,int> p(bcase.anchors[i], bcase.others[i]);
+	      data.hasPathDfs(bcase.rulesFrom[i], p);
+	    }
+	  });
+	data.setPlanRuleWalks(true);
+	timeKernel(dataset, "hasPath", "plan", repeated, length, anchorType, n, minSeconds, [&]() {
+	    for(int i=0; i<n; i++) {
+	      pair<int,int> p(bcase.anchors[i], bcase.others[i]);
+	      data.hasPath(bcase.rulesFrom[i], p);
+	    }
+	  });
+	for(int bfs=2; bfs>=0; bfs--) {
+	  // 2 leaves the choice to the planner
+	  data.setPlanRuleWalks(bfs == 2);
+	  string search = (bfs == 2 ? "plan" : bfs ? "BFS" : "DFS");
+	  timeKernel(dataset, "rightEntities", search, repeated, length, anchorType, n, minSeconds, [&]() {
+	      for(int i=0; i<n; i++) {
+		set<int> destIds;
+		data.getRightEntities(bcase.rulesFrom[i], bcase.anchors[i], destIds, bfs == 1);
+	      }
+	    });
+	  timeKernel(dataset, "leftEntities", search, repeated, length, anchorType, n, minSeconds, [&]() {
+	      for(int i=0; i<n; i++) {
+		set<int> origIds;
+		data.getLeftEntities(bcase.rulesTo[i], bcase.anchors[i], origIds, bfs == 1);
+	      }
+	    });
+	}
+
+	// these do not depend on the setting of repeated nodes
+	if(repeated) continue;
+	params.addMaxRuleLength(length);
+	timeKernel(dataset, "find_sp", "BFS", repeated, length, anchorType, n, minSeconds, [&]() {
+	    for(int i=0; i<n; i++) {
+	      Rule rule;
+	      solver.find_sp(bcase.anchors[i], bcase.ends[i], -1, NULL, distance, prev, prevrel, tnodes, rule, firstrel, firstinvrel);
+	    }
+	  });
+	if(length == 1) {
+	  timeKernel(dataset, "entitiesOfInterest", "-", repeated, 0, anchorType, n, minSeconds, [&]() {
+	      for(int i=0; i<n; i++)
+		solver.getEntitiesOfInterestForHead(bcase.rulesFrom[i].getRelationIds()[0], bcase.anchors[i], useEntity);
+	    });
+	}
+      }
+    }
+  }
+}
+
+int
+main (int argc, char* argv[])
+{
+  string paramsFileName = "";
+  vector<string> directories;
+  bool synthetic = false;
+  string syntheticDirectory = "bench_synthetic";
+  int numEntities = 100000;
+  long numTriples = 1000000;
+  int numAnchors = 20;
+  int maxLength = 5;
+  double minSeconds = 0.2;
+
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    if (i+1 < argc && arg == "-p")
+      paramsFileName = argv[++i];
+    else if (i+1 < argc && arg == "-d")
+      directories.push_back(argv[++i]);
+    else if (arg == "-g")
+      synthetic = true;
+    else if (i+1 < argc && arg == "-e")
+      numEntities = atoi(argv[++i]);
+    else if (i+1 < argc && arg == "-t")
+      numTriples = atol(argv[++i]);
+    else if (i+1 < argc && arg == "-a")
+      numAnchors = atoi(argv[++i]);
+    else if (i+1 < argc && arg == "-l")
+      maxLength = atoi(argv[++i]);
+    else if (i+1 < argc && arg == "-m")
+      minSeconds = atof(argv[++i]);
+    else {
+      cerr<<"Usage: "<<argv[0]<<" -p parameters_file_name -d data_directory ... -g -e synthetic_entities -t synthetic_triples -a anchors -l max_rule_length -m min_seconds_per_case"<<endl;
+      return 1;
+    }
+  }
+  if(directories.size() == 0 && !synthetic) {
+    directories.push_back("../data/Kinship");
+    directories.push_back("../data/UMLS");
+    directories.push_back("../data/WN18RR");
+  }
+
+  Parameters params = Parameters();
+  if(paramsFileName != "")
+    params.readParamsFile(paramsFileName);
+
+  if(synthetic) {
+    KGGenerator generator;
+    generator.setNumEntities(numEntities);
+    generator.setNumTriples(numTriples);
+    generator.generate();
+    generator.writeFiles(syntheticDirectory);
+    directories.push_back(syntheticDirectory);
+  }
+
+  cout<<left<<setw(12)<<"dataset"<<" "<<setw(18)<<"kernel"<<" "<<setw(4)<<"srch"
+      <<" "<<setw(8)<<"repeated"<<" "<<right<<setw(6)<<"length"
+      <<" "<<left<<setw(7)<<"anchors"<<" "<<right<<setw(10)<<"ops"
+      <<" "<<setw(12)<<"ns/op"<<" "<<setw(12)<<"edges/sec"<<endl;
+  for(int i=0; i<(int)directories.size(); i++) {
+    string dataset = directories[i];
+    size_t pos = dataset.find_last_of('/');
+    if(pos != string::npos)
+      dataset = dataset.substr(pos+1);
+    params.addDirectory(directories[i]);
+    runBenchmarks(dataset, params, numAnchors, maxLength, minSeconds);
+  }
+  return 0;
+}
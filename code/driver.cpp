@@ -8,6 +8,7 @@
 #include <iomanip>
 
 #include <ctime>
+#include <chrono>
 #if !defined(_MSC_VER)
 #include <sys/resource.h>
 #endif
@@ -26,11 +27,28 @@ double getTime()
   return cpuTime;
 }
 
+// user plus system time of all the threads, and the peak resident
+// set size in KB (0 where getrusage is not available)
+void getResources(double& cpuTime, long& peakRSS)
+{
+#ifdef _MSC_VER
+  cpuTime=static_cast<double> (clock()) /static_cast<double>(CLOCKS_PER_SEC);
+  peakRSS = 0;
+#else
+  struct rusage usage;
+  getrusage(RUSAGE_SELF,&usage);
+  cpuTime = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec;
+  cpuTime += 1.0e-6*(static_cast<double> (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec));
+  peakRSS = usage.ru_maxrss;
+#endif
+}
+
 
 int
 main (int argc, char* argv[])
 {
   double startTime = getTime();
+  chrono::steady_clock::time_point startWallTime = chrono::steady_clock::now();
 
   string paramsFileName = "run_parameters.txt";
   string scoresFileName = "scores.txt";
@@ -89,7 +107,7 @@ main (int argc, char* argv[])
   }
   params.printParams();
 
-  Solver solver = Solver(params);
+  Solver solver(params);
   remove(scoresFileName.c_str());
   remove(rulesFileName.c_str());
   solver.run(scoresFileName, rulesFileName, inputRulesFileName);
@@ -97,4 +115,11 @@ main (int argc, char* argv[])
   //  solver.writeScoresToFile("scores.txt");
 
   cout<<"Total Time: "<<getTime()-startTime<<endl;
+
+  // one line that the benchmark runner (runs/run_benchmarks.sh) parses
+  double cpuTime;
+  long peakRSS;
+  getResources(cpuTime, peakRSS);
+  chrono::duration<double> wallTime = chrono::steady_clock::now() - startWallTime;
+  cout<<"Resources: wall_time "<<wallTime.count()<<" cpu_time "<<cpuTime<<" peak_rss_kb "<<peakRSS<<endl;
 }
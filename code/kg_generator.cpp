@@ -0,0 +1,57 @@
+// © Copyright IBM Corporation 2022. All Rights Reserved.
+// LICENSE: Eclipse Public License - v 2.0, https://opensource.org/licenses/EPL-2.0
+// SPDX-License-Identifier: EPL-2.0
+
+// Writes a synthetic knowledge graph with planted rules to a data
+// directory that can be given to lprules with data_directory. The
+// planted rules are written to planted_rules.txt in the same directory.
+
+#include "KGGenerator.hpp"
+
+#include <iostream>
+#include <cstdlib>
+
+using namespace std;
+
+int
+main (int argc, char* argv[])
+{
+  string dname = "synthetic";
+  KGGenerator generator;
+
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    if (i+1 < argc && arg == "-o")
+      dname = argv[++i];
+    else if (i+1 < argc && arg == "-e")
+      generator.setNumEntities(atoi(argv[++i]));
+    else if (i+1 < argc && arg == "-r")
+      generator.setNumRelations(atoi(argv[++i]));
+    else if (i+1 < argc && arg == "-t")
+      generator.setNumTriples(atol(argv[++i]));
+    else if (i+1 < argc && arg == "-a")
+      generator.setDegreeExponent(atof(argv[++i]));
+    else if (i+1 < argc && arg == "-n")
+      generator.setNumRules(atoi(argv[++i]));
+    else if (i+1 < argc && arg == "-l")
+      generator.setRuleLength(atoi(argv[++i]));
+    else if (i+1 < argc && arg == "-i")
+      generator.setNumInstances(atol(argv[++i]));
+    else if (i+1 < argc && arg == "-c")
+      generator.setConfidence(atof(argv[++i]));
+    else if (i+1 < argc && arg == "-v")
+      generator.setValidFraction(atof(argv[++i]));
+    else if (i+1 < argc && arg == "-x")
+      generator.setTestFraction(atof(argv[++i]));
+    else if (i+1 < argc && arg == "-s")
+      generator.setSeed(strtoull(argv[++i], NULL, 10));
+    else {
+      cerr<<"Usage: "<<argv[0]<<" -o output_directory -e entities -r relations -t background_triples -a degree_exponent -n planted_rules -l rule_length -i instances_per_rule -c confidence -v valid_fraction -x test_fraction -s seed"<<endl;
+      return 1;
+    }
+  }
+
+  generator.generate();
+  generator.writeFiles(dname);
+  return 0;
+}
@@ -0,0 +1,94 @@
+// © Copyright IBM Corporation 2022. All Rights Reserved.
+// LICENSE: Eclipse Public License - v 2.0, https://opensource.org/licenses/EPL-2.0
+// SPDX-License-Identifier: EPL-2.0
+
+// Answers link prediction queries read from stdin, one per line:
+//   head relation ?    returns the top-k tails
+//   ? relation tail    returns the top-k heads
+// For each query it prints the query line, then one line per answer
+// with the rank, the entity and its score, and then an empty line.
+
+#include "Parameters.hpp"
+#include "Data.hpp"
+#include "QueryEngine.hpp"
+
+int
+main (int argc, char* argv[])
+{
+  string paramsFileName = "run_parameters.txt";
+  string rulesFileName = "rules.txt";
+  int k = 10;
+
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    if (arg == "-p") {
+      if (i+1 < argc) {
+	i++;
+	paramsFileName = argv[i];
+      }
+    }
+    else if (arg == "-r") {
+      if (i+1 < argc) {
+	i++;
+	rulesFileName = argv[i];
+      }
+    }
+    else if (arg == "-k") {
+      if (i+1 < argc) {
+	i++;
+	k = atoi(argv[i]);
+      }
+    }
+    else if (arg == "-h") {
+      cerr<<"Usage: "<<argv[0]<<" -p parameters_file_name -r rules_file_name -k number_of_answers < queries"<<endl;
+      return 1;
+    }
+  }
+
+  Parameters params = Parameters();
+  params.readParamsFile(paramsFileName);
+
+  Data data(params.getMaxComplexity());
+  data.readData(params);
+  QueryEngine engine(data, params.getUseBreadthFirstSearch());
+  int numRules = engine.readRulesFile(rulesFileName);
+  cerr<<"Rules read: "<<numRules<<endl;
+
+  map<string,int>& mapentities = data.getMapEntities();
+  map<string,int>& maprelations = data.getMapRelations();
+  vector<string>& entities = data.getEntities();
+
+  string s;
+  vector<pair<int,double> > results;
+  while (getline( cin, s )) {
+    string stemp1, stemp2, stemp3;
+    istringstream ss( s );
+    if(!(ss >> stemp1 >> stemp2 >> stemp3))
+      continue;
+
+    map<string,int>::iterator itrel = maprelations.find(stemp2);
+    if(itrel == maprelations.end()) {
+      cerr<<"Unknown relation: "<<stemp2<<endl;
+      continue;
+    }
+    bool askTails = (stemp3 == "?");
+    string entity = askTails ? stemp1 : stemp3;
+    map<string,int>::iterator itent = mapentities.find(entity);
+    if(itent == mapentities.end()) {
+      cerr<<"Unknown entity: "<<entity<<endl;
+      continue;
+    }
+
+    if(askTails)
+      engine.queryTails(itent->second, itrel->second, k, results);
+    else
+      engine.queryHeads(itent->second, itrel->second, k, results);
+
+    cout<<s<<endl;
+    for(int i=0; i<(int)results.size(); i++)
+      cout<<i+1<<"\t"<<entities[results[i].first]<<"\t"<<results[i].second<<endl;
+    cout<<endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,107 @@
+#!/bin/bash
+
+# © Copyright IBM Corporation 2022. All Rights Reserved.
+# LICENSE: Eclipse Public License - v 2.0, https://opensource.org/licenses/EPL-2.0
+# SPDX-License-Identifier: EPL-2.0
+
+# to run type:
+# ./run_benchmarks.sh [configFile] [resultsFile] [baselineFile]
+# Runs lprules once for every line "name directory parameterFile" of
+# configFile (default benchmarks.txt) and writes one line per benchmark
+# to resultsFile (default benchmark_results.txt):
+#   name wall_time cpu_time peak_rss_kb lp_solve_time mr mrr hits1 hits3 hits10
+# The times are in seconds, lp_solve_time is the sum of the LP solves,
+# and MR, MRR and hits@k are the filtered RIGHT and LEFT statistics.
+# If baselineFile (default benchmark_baseline.txt) exists, the results
+# are compared with it and the script exits with status 1 if a benchmark
+# - takes more time or memory than the baseline by more than
+#   TIME_TOLERANCE (relative, default 0.10) and, for the times, by more
+#   than TIME_SLACK seconds (default 1.0), or has a larger MR by more than
+#   TIME_TOLERANCE
+# - has an MRR or hits@k lower than the baseline by more than
+#   ACCURACY_TOLERANCE (absolute, default 0.005)
+# To make the results the new baseline, copy resultsFile to baselineFile.
+
+# Configuration, results and baseline filenames
+CONFIG=$(realpath -m ${1:-benchmarks.txt})
+RESULTS=$(realpath -m ${2:-benchmark_results.txt})
+BASELINE=$(realpath -m ${3:-benchmark_baseline.txt})
+# Tolerances
+TIME_TOLERANCE=${TIME_TOLERANCE:-0.10}
+TIME_SLACK=${TIME_SLACK:-1.0}
+ACCURACY_TOLERANCE=${ACCURACY_TOLERANCE:-0.005}
+# Executable, relative to the directories of the benchmarks
+EXEC=../../code/lprules
+# Directory of the benchmarks
+RUNSDIR=$(cd $(dirname $0) && pwd)
+
+echo "# name wall_time cpu_time peak_rss_kb lp_solve_time mr mrr hits1 hits3 hits10" > $RESULTS
+
+while read NAME DIR PARAMS
+do
+    case "$NAME" in
+	""|\#*) continue ;;
+    esac
+    echo "Running $NAME"
+    SCORES=scores_bench_$NAME.txt
+    RULES=rules_bench_$NAME.txt
+    LOG=log_bench_$NAME.txt
+    (cd $RUNSDIR/$DIR && $EXEC -p $PARAMS -s $SCORES -r $RULES > $LOG 2>&1 < /dev/null)
+
+    # "Resources: wall_time W cpu_time C peak_rss_kb R" is the last line of the log
+    RESOURCES=$(grep "^Resources:" $RUNSDIR/$DIR/$LOG | awk '{print $3, $5, $7}')
+    if [ -z "$RESOURCES" ]; then
+	echo "$NAME did not finish, see $RUNSDIR/$DIR/$LOG"
+	RESOURCES="nan nan nan"
+    fi
+    LPTIME=$(grep "LP solve: wall time" $RUNSDIR/$DIR/$LOG | awk '{sum += $5} END {printf "%.3f", sum}')
+    ACCURACY=$(grep rd_mr_mrr_1_3_10_n $RUNSDIR/$DIR/$SCORES 2>/dev/null | awk -v OFMT=%.17g '{mr += $2; mrr += $3; h1 += $4; h3 += $5; h10 += $6; n += $7} END {if (n > 0) print mr/n, mrr/n, h1/n, h3/n, h10/n; else print "nan nan nan nan nan"}')
+    echo "$NAME $RESOURCES $LPTIME $ACCURACY" >> $RESULTS
+done < $CONFIG
+
+cat $RESULTS
+
+if [ ! -f $BASELINE ]; then
+    echo "No baseline $BASELINE, nothing to compare"
+    exit 0
+fi
+
+awk -v tt=$TIME_TOLERANCE -v ts=$TIME_SLACK -v at=$ACCURACY_TOLERANCE '
+BEGIN {
+    split("name wall_time cpu_time peak_rss_kb lp_solve_time mr mrr hits1 hits3 hits10", column, " ");
+    regressions = 0;
+}
+$1 ~ /^#/ { next }
+FNR == NR { baseline[$1] = $0; next }
+!($1 in baseline) { print $1 ": not in the baseline"; next }
+{
+    split(baseline[$1], b, " ");
+    for (i = 2; i <= 10; i++) {
+	if ($i == "nan" || b[i] == "nan") {
+	    if ($i != b[i]) {
+		print $1 " " column[i] ": " b[i] " -> " $i " REGRESSION";
+		regressions++;
+	    }
+	    continue;
+	}
+	new = $i + 0;
+	old = b[i] + 0;
+	if (i <= 6) { # lower is better, relative tolerance
+	    slack = (i == 2 || i == 3 || i == 5) ? ts : 0;
+	    bad = (new > old * (1 + tt) && new - old > slack);
+	}
+	else # higher is better, absolute tolerance
+	    bad = (new < old - at);
+	if (bad) {
+	    print $1 " " column[i] ": " old " -> " new " REGRESSION";
+	    regressions++;
+	}
+    }
+}
+END {
+    if (regressions > 0) {
+	print regressions " regressions with respect to the baseline";
+	exit 1;
+    }
+    print "No regressions with respect to the baseline";
+}' $BASELINE $RESULTS